@@ -0,0 +1,200 @@
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sanitizer/common_interface_defs.h>
+#include "parser.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Input being executed, saved to 'crash_path' if the process dies on it
+static const BYTE *current_input = NULL;
+static size_t current_size = 0;
+static const char *current_file = NULL;
+static uint64_t current_exec = 0;
+static unsigned int current_seed = 0;
+static char crash_path[64];
+
+static char *append_str(char *dst, const char *src) {
+    /*
+     * Copies 'src' to 'dst' without its terminator
+     * Returns position after the copied characters
+     */
+
+    while (*src != '\0') {
+        *dst++ = *src++;
+    }
+    return dst;
+}
+
+static char *append_u64(char *dst, uint64_t value) {
+    /*
+     * Writes the decimal digits of 'value'
+     * Returns position after the written characters
+     */
+
+    char digits[20];
+    int num_digits = 0;
+    do {
+        digits[num_digits ++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (num_digits > 0) {
+        *dst++ = digits[-- num_digits];
+    }
+    return dst;
+}
+
+static void save_crash(void) {
+    /*
+     * Writes the input being executed to 'crash_path' and reports where it
+     * came from. Only uses write(2) so that it is safe in a signal handler
+     */
+
+    static int saved = 0;
+    if (current_input == NULL || saved) {
+        return;
+    }
+    saved = 1;
+
+    int fd = open(crash_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd != -1) {
+        if (write(fd, current_input, current_size) < 0) {
+            // Nothing more can be done while dying
+        }
+        close(fd);
+    }
+
+    char msg[512];
+    char *end = append_str(msg, "Crash on exec ");
+    end = append_u64(end, current_exec);
+    end = append_str(end, " (from ");
+    size_t len = strnlen(current_file, 256);
+    memcpy(end, current_file, len);
+    end += len;
+    end = append_str(end, "), seed ");
+    end = append_u64(end, current_seed);
+    end = append_str(end, "; input saved to ");
+    end = append_str(end, crash_path);
+    *end++ = '\n';
+    if (write(STDERR_FILENO, msg, end - msg) < 0) {
+        // As above
+    }
+}
+
+static void on_abort(int sig) {
+    /*
+     * Saves the crashing input, then dies with the original signal
+     */
+
+    save_crash();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static void run_input(const BYTE *input, size_t size, const char *file,
+                      uint64_t exec) {
+    /*
+     * Runs one input, recording it as the one to save if it crashes
+     */
+
+    current_input = input;
+    current_size = size;
+    current_file = file;
+    current_exec = exec;
+    LLVMFuzzerTestOneInput(input, size);
+    current_input = NULL;
+}
+
+/*
+ * Stand-in for libFuzzer when the compiler does not support
+ * -fsanitize=fuzzer: replays each input file, optionally with random bit
+ * flips, through the same entry point and reports executions per second
+ * An input that crashes is saved to crash-<seed>, which can be replayed by
+ * passing it as the only file
+ */
+
+int main(int argc, char **argv) {
+    // Handles command line options
+    long runs = 1;
+    long mutations = 0;
+    unsigned int seed = time(NULL);
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                runs = strtol(optarg, NULL, 10);
+                break;
+            case 'm':
+                mutations = strtol(optarg, NULL, 10);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                return 1;
+        }
+    }
+    if (argc - optind < 1) {
+        printf("Usage: %s [-n runs] [-m mutations] [-s seed] <file>...\n",
+               argv[0]);
+        return 1;
+    }
+    srand(seed);
+
+    // Sanitizer reports exit through the death callback, assertions and
+    // memory faults through signals
+    current_seed = seed;
+    snprintf(crash_path, sizeof(crash_path), "crash-%u", seed);
+    __sanitizer_set_death_callback(save_crash);
+    signal(SIGABRT, on_abort);
+    signal(SIGSEGV, on_abort);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t execs = 0;
+
+    for (int i = optind; i < argc; i ++) {
+        FILE *file = fopen(argv[i], "rb");
+        if (file == NULL) {
+            perror(argv[i]);
+            continue;
+        }
+        BYTE input[BUF];
+        size_t size = fread(input, 1, BUF, file);
+        fclose(file);
+
+        for (long run = 0; run < runs; run ++) {
+            run_input(input, size, argv[i], execs);
+            execs ++;
+        }
+
+        // Each mutant flips one to four random bits of the original input
+        BYTE mutant[BUF];
+        for (long m = 0; m < mutations && size > 0; m ++) {
+            for (size_t j = 0; j < size; j ++) {
+                mutant[j] = input[j];
+            }
+            int flips = 1 + rand() % 4;
+            for (int f = 0; f < flips; f ++) {
+                int bit = rand() % (size * BYTE_SIZE);
+                mutant[bit / BYTE_SIZE] ^= 1 << (bit % BYTE_SIZE);
+            }
+            run_input(mutant, size, argv[i], execs);
+            execs ++;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) +
+                     (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%llu execs in %.3fs (%.0f exec/s), seed %u\n",
+            (unsigned long long) execs, seconds,
+            seconds > 0 ? execs / seconds : 0.0, seed);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm.h"
+#include "inline.h"
+
+#define FUZZ_BUDGET 100000 // Instructions executed per input before giving up
+#define FRAME_SIZE (SYM_BUF + RET_OFFSET)
+
+static int same_state(struct vm *vm, struct vm *inlined) {
+    /*
+     * Returns 1 if both machines hold the same values everywhere a program
+     * can read. Inlining only leaves out the return address slots (which
+     * frames start on multiples of FRAME_SIZE when it applies) and the stack
+     * pointer a RET would have set
+     */
+
+    for (int i = 0; i < RAM_LIMIT; i ++) {
+        if (i % FRAME_SIZE < SYM_BUF && vm->ram[i] != inlined->ram[i]) {
+            return 0;
+        }
+    }
+    for (int i = 0; i < PROG_CTR; i ++) {
+        if (i != STK_PTR && vm->reg[i] != inlined->reg[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    /*
+     * Parses and runs one input in-process with an instruction budget.
+     * Malformed inputs and program errors come back as status codes, so
+     * anything the sanitizers report is a real bug
+     * The input is run again after inlining, which must print the same output
+     * and fail the same way or finish with the same readable state
+     */
+
+    static struct vm vm;
+    static struct vm inlined;
+    if (size == 0 || size > BUF) {
+        return 0;
+    }
+
+    BYTE f_bits[BUF];
+    memcpy(f_bits, data, size);
+    int num_func = parse(vm.code_mem, MAX_FUNC, &f_bits[size - 1], size);
+    if (num_func < 0) {
+        return 0;
+    }
+    vm.num_instruct = num_func;
+
+    int main_address = get_func(&vm, 0);
+    if (main_address == NO_VAL) {
+        return 0;
+    }
+    memcpy(inlined.code_mem, vm.code_mem, sizeof(vm.code_mem));
+    inlined.num_instruct = num_func;
+    inline_leaves(inlined.code_mem, num_func, INLINE_DEFAULT_THRESHOLD);
+
+    char *output = NULL;
+    size_t output_len = 0;
+    vm_init(&vm, main_address);
+    vm.out = open_memstream(&output, &output_len);
+    int status = vm_run(&vm, FUZZ_BUDGET, NULL);
+    fclose(vm.out);
+
+    char *inlined_output = NULL;
+    size_t inlined_len = 0;
+    vm_init(&inlined, main_address);
+    inlined.out = open_memstream(&inlined_output, &inlined_len);
+    int inlined_status = vm_run(&inlined, FUZZ_BUDGET, NULL);
+    fclose(inlined.out);
+
+    // Inlined code dispatches fewer instructions, so only runs that both
+    // finished within the budget are compared
+    int differs = 0;
+    if (status != VM_LIMIT && inlined_status != VM_LIMIT) {
+        differs = (status != inlined_status || output_len != inlined_len ||
+                   memcmp(output, inlined_output, output_len) != 0 ||
+                   (status == VM_OK && !same_state(&vm, &inlined)));
+    }
+    free(output);
+    free(inlined_output);
+    if (differs) {
+        abort();
+    }
+    return 0;
+}
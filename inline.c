@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include <string.h>
+#include "inline.h"
+
+// Matches the frame layout used by the VM
+#define FRAME_SIZE (SYM_BUF + 2)
+#define RAM_SIZE 256
+#define FIRST_RESERVED_REG 4    // Frame, stack, function and PC registers
+#define STACK_REG 5
+#define PC_REG 7
+#define NO_FUNC -1
+
+static int find_func(struct function *funcs, int num_func, uint8_t label) {
+    /*
+     * Returns index of the only function labelled 'label', or NO_FUNC if
+     * there is not exactly one, as the VM resolves CAL
+     */
+
+    int result = NO_FUNC;
+    int count = 0;
+    for (int i = 0; i < num_func; i ++) {
+        if (funcs[i].label == label) {
+            result = i;
+            count ++;
+        }
+    }
+    return count == 1 ? result : NO_FUNC;
+}
+
+static int has_dynamic_flow(struct function *funcs, int num_func) {
+    /*
+     * Returns 1 if any instruction has a PTR argument or writes the frame,
+     * stack, function or PC registers. Only PTR can reach the return address
+     * slots, which inlined calls no longer fill in, and a PTR write or one of
+     * the registers can move the frame or the code being run, so frame
+     * depths are no longer known statically
+     */
+
+    for (int i = 0; i < num_func; i ++) {
+        for (int j = 0; j < funcs[i].num_instruct; j ++) {
+            struct instruction *instruct = &funcs[i].instructions[j];
+            for (int k = 0; k < instruct->num_args; k ++) {
+                if (instruct->type[k] == PTR) {
+                    return 1;
+                }
+            }
+
+            int dest = instruct->num_args - 1;
+            if (instruct->operation != PRINT && instruct->operation != CAL &&
+                dest >= 0 && instruct->type[dest] == REG &&
+                instruct->val[dest] >= FIRST_RESERVED_REG) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int live_length(struct function *func) {
+    /*
+     * Returns number of instructions before the first RET, which is all that
+     * can execute, or -1 if the function has no RET
+     */
+
+    for (int i = 0; i < func->num_instruct; i ++) {
+        if (func->instructions[i].operation == RET) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int leaf_size(struct function *funcs, int num_func, int index,
+                     int threshold, int *max_slot) {
+    /*
+     * Returns body length of function 'index' if it can be inlined: it is not
+     * main(), returns after at most 'threshold' instructions without making a
+     * call, and does not name the frame, stack, function or PC registers,
+     * which hold different values once inlined. Sets 'max_slot' to the
+     * largest stack symbol it uses
+     * Returns -1 if it cannot be inlined
+     */
+
+    struct function *func = &funcs[index];
+    int length = live_length(func);
+    if (length < 0 || length > threshold ||
+        index == find_func(funcs, num_func, 0)) {
+        return -1;
+    }
+
+    *max_slot = 0;
+    for (int i = 0; i < length; i ++) {
+        struct instruction *instruct = &func->instructions[i];
+        if (instruct->operation == CAL) {
+            return -1;
+        }
+        for (int j = 0; j < instruct->num_args; j ++) {
+            if (instruct->type[j] == REG &&
+                instruct->val[j] >= FIRST_RESERVED_REG) {
+                return -1;
+            }
+            if (instruct->type[j] == STK && instruct->val[j] > *max_slot) {
+                *max_slot = instruct->val[j];
+            }
+        }
+    }
+    return length;
+}
+
+static void mark_unbounded(struct function *funcs, int num_func, int index,
+                           uint8_t unbounded[]) {
+    /*
+     * Marks function 'index' and everything it can call as having no
+     * static bound on frame depth
+     */
+
+    if (unbounded[index]) {
+        return;
+    }
+    unbounded[index] = 1;
+    struct function *func = &funcs[index];
+    for (int i = 0; i < func->num_instruct; i ++) {
+        struct instruction *instruct = &func->instructions[i];
+        if (instruct->operation == CAL && instruct->type[0] == VAL) {
+            int callee = find_func(funcs, num_func, instruct->val[0]);
+            if (callee != NO_FUNC) {
+                mark_unbounded(funcs, num_func, callee, unbounded);
+            }
+        }
+    }
+}
+
+static void find_depths(struct function *funcs, int num_func, int index,
+                        int depth, int depths[], uint8_t on_path[],
+                        uint8_t unbounded[]) {
+    /*
+     * Records in 'depths' the deepest frame each function reachable from
+     * 'index' runs in, main() being depth 0. Functions reachable through
+     * recursion are marked in 'unbounded' instead
+     */
+
+    if (on_path[index]) {
+        mark_unbounded(funcs, num_func, index, unbounded);
+        return;
+    }
+    if (depth > depths[index]) {
+        depths[index] = depth;
+    }
+
+    on_path[index] = 1;
+    struct function *func = &funcs[index];
+    uint8_t visited[MAX_FUNC] = {0};
+    for (int i = 0; i < func->num_instruct; i ++) {
+        struct instruction *instruct = &func->instructions[i];
+        if (instruct->operation != CAL || instruct->type[0] != VAL) {
+            continue;
+        }
+        int callee = find_func(funcs, num_func, instruct->val[0]);
+        if (callee != NO_FUNC && !visited[callee]) {
+            visited[callee] = 1;
+            find_depths(funcs, num_func, callee, depth + 1, depths, on_path,
+                        unbounded);
+        }
+    }
+    on_path[index] = 0;
+}
+
+static struct instruction make_instruction(enum opcode operation,
+                                           enum val_type dest_type,
+                                           uint8_t dest,
+                                           enum val_type src_type,
+                                           uint8_t src) {
+    /*
+     * Returns two argument instruction, arguments given in objdump order
+     */
+
+    struct instruction instruct = {0};
+    instruct.operation = operation;
+    instruct.num_args = 2;
+    instruct.type[1] = dest_type;
+    instruct.val[1] = dest;
+    instruct.type[0] = src_type;
+    instruct.val[0] = src;
+    return instruct;
+}
+
+static void inline_calls(struct function *funcs, int caller, uint8_t sites[],
+                         int callees[], int keep_sp) {
+    /*
+     * Replaces each CAL in 'caller' marked in 'sites' with the body of
+     * function 'callees[i]'. Callee symbols are remapped to the region past
+     * the caller's symbols and return slots, where the callee's frame would
+     * have been, so the memory it writes is unchanged. If 'keep_sp' is set,
+     * REF also leaves the stack pointer where RET would
+     */
+
+    struct function *func = &funcs[caller];
+    struct instruction result[32];
+    int length = 0;
+
+    for (int i = 0; i < func->num_instruct; i ++) {
+        if (!sites[i]) {
+            result[length ++] = func->instructions[i];
+            continue;
+        }
+
+        struct function *callee = &funcs[callees[i]];
+        int body = live_length(callee);
+        for (int j = 0; j < body; j ++) {
+            struct instruction instruct = callee->instructions[j];
+            for (int k = 0; k < instruct.num_args; k ++) {
+                if (instruct.type[k] == STK) {
+                    instruct.val[k] += FRAME_SIZE;
+                }
+            }
+            result[length ++] = instruct;
+        }
+
+        if (keep_sp) {
+            result[length ++] = make_instruction(REF, REG, STACK_REG, STK,
+                                                 SYM_BUF);
+        }
+    }
+
+    memcpy(func->instructions, result, length * sizeof(struct instruction));
+    func->num_instruct = length;
+}
+
+int inline_leaves(struct function *funcs, int num_func, int threshold) {
+    /*
+     * Splices calls to small leaf functions into their callers. Output and
+     * every memory location the program can read stay exactly as if the
+     * calls had been made; only the unreadable return address slots differ
+     * Returns number of calls inlined
+     */
+
+    int main_address = find_func(funcs, num_func, 0);
+    if (num_func > MAX_FUNC || main_address == NO_FUNC ||
+        has_dynamic_flow(funcs, num_func)) {
+        return 0;
+    }
+
+    int depths[MAX_FUNC];
+    for (int i = 0; i < num_func; i ++) {
+        depths[i] = -1;
+    }
+    uint8_t on_path[MAX_FUNC] = {0};
+    uint8_t unbounded[MAX_FUNC] = {0};
+    find_depths(funcs, num_func, main_address, 0, depths, on_path, unbounded);
+
+    // Decides for every caller before changing any function, since callees
+    // are inlined as they were parsed
+    uint8_t sites[MAX_FUNC][32] = {{0}};
+    int callees[MAX_FUNC][32];
+    int keep_sp[MAX_FUNC] = {0};
+    int total = 0;
+    for (int caller = 0; caller < num_func; caller ++) {
+        struct function *func = &funcs[caller];
+        int live = live_length(func);
+        if (depths[caller] < 0 || unbounded[caller] || live < 0) {
+            continue;
+        }
+
+        // The caller's own PC register changes meaning once code moves. The
+        // stack pointer only needs restoring if the caller reads it, since
+        // the next CAL or RET sets it again
+        int reads_pc = 0;
+        for (int i = 0; i < func->num_instruct; i ++) {
+            struct instruction *instruct = &func->instructions[i];
+            for (int j = 0; j < instruct->num_args; j ++) {
+                if (instruct->type[j] == REG) {
+                    reads_pc |= (instruct->val[j] == PC_REG);
+                    keep_sp[caller] |= (instruct->val[j] == STACK_REG);
+                }
+            }
+        }
+        if (reads_pc) {
+            continue;
+        }
+
+        // Each inlined call replaces CAL with the callee's body, and RET with
+        // REF if the stack pointer is kept
+        int frame = depths[caller] * FRAME_SIZE;
+        int length = func->num_instruct;
+        int extra = keep_sp[caller] ? 0 : -1;
+        for (int i = 0; i < live; i ++) {
+            struct instruction *instruct = &func->instructions[i];
+            if (instruct->operation != CAL) {
+                continue;
+            }
+            int callee = NO_FUNC;
+            if (instruct->type[0] == VAL) {
+                callee = find_func(funcs, num_func, instruct->val[0]);
+            }
+            int max_slot;
+            int body = -1;
+            if (callee != NO_FUNC) {
+                body = leaf_size(funcs, num_func, callee, threshold,
+                                 &max_slot);
+            }
+
+            // Callee's frame must fit in RAM, as the CAL would have checked
+            if (body < 0 || frame + FRAME_SIZE + max_slot >= RAM_SIZE ||
+                length + body + extra > 32) {
+                continue;
+            }
+            length += body + extra;
+            sites[caller][i] = 1;
+            callees[caller][i] = callee;
+            total ++;
+        }
+    }
+
+    for (int caller = 0; caller < num_func; caller ++) {
+        inline_calls(funcs, caller, sites[caller], callees[caller],
+                     keep_sp[caller]);
+    }
+    return total;
+}
+
+int parse_inline_threshold(const char *text) {
+    /*
+     * Returns the threshold written in 'text', or -1 if it is not a number
+     * from 0 to INLINE_MAX_THRESHOLD
+     */
+
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value < 0 ||
+        value > INLINE_MAX_THRESHOLD) {
+        return -1;
+    }
+    return value;
+}
@@ -0,0 +1,14 @@
+#ifndef INLINE_H
+#define INLINE_H
+
+#include "objects.h"
+#include "parser.h"
+
+#define INLINE_DEFAULT_THRESHOLD 3  // Largest callee body inlined, RET excluded
+#define INLINE_MAX_THRESHOLD 31     // Longest body a function can have
+
+int parse_inline_threshold(const char *text);
+
+int inline_leaves(struct function *funcs, int num_func, int threshold);
+
+#endif
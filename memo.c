@@ -0,0 +1,414 @@
+#include <string.h>
+#include "memo.h"
+
+#define REG_LOC(reg) (RAM_LIMIT + (reg))
+
+static uint8_t load(struct vm *vm, int loc) {
+    /*
+     * Returns value currently held at location 'loc'
+     */
+
+    return loc < RAM_LIMIT ? vm->ram[loc] : vm->reg[loc - RAM_LIMIT];
+}
+
+static void store(struct vm *vm, int loc, uint8_t value) {
+    /*
+     * Sets location 'loc' to 'value'
+     */
+
+    if (loc < RAM_LIMIT) {
+        vm->ram[loc] = value;
+    } else {
+        vm->reg[loc - RAM_LIMIT] = value;
+    }
+}
+
+struct memo *memo_create(struct vm *vm) {
+    /*
+     * Finds the functions whose calls can be memoized: those that cannot
+     * PRINT, call main() (whose RET ends the program), make an invalid CAL or
+     * write the function or PC register (which jumps elsewhere), directly or
+     * through any function they call
+     * Returns new memo table, or NULL if it could not be allocated
+     */
+
+    struct memo *memo = calloc(1, sizeof(struct memo));
+    if (memo == NULL) {
+        return NULL;
+    }
+
+    int main_address = get_func(vm, 0);
+    int callees[MAX_FUNC][32];
+    int num_callees[MAX_FUNC] = {0};
+    for (int i = 0; i < vm->num_instruct; i ++) {
+        struct function *func = &vm->code_mem[i];
+        memo->eligible[i] = (i != main_address);
+        for (int j = 0; j < func->num_instruct; j ++) {
+            struct instruction *instruct = &func->instructions[j];
+            int dest = instruct->num_args - 1;
+            if (instruct->operation == PRINT) {
+                memo->eligible[i] = 0;
+            } else if (instruct->operation != CAL && dest >= 0 &&
+                       instruct->type[dest] == REG &&
+                       instruct->val[dest] >= FUNC_PTR) {
+                memo->eligible[i] = 0;
+            } else if (instruct->operation == CAL) {
+                int callee = NO_VAL;
+                if (instruct->type[0] == VAL) {
+                    callee = get_func(vm, instruct->val[0]);
+                }
+                if (callee == NO_VAL) {
+                    memo->eligible[i] = 0;
+                } else {
+                    callees[i][num_callees[i] ++] = callee;
+                }
+            }
+        }
+    }
+
+    // Propagates ineligibility to callers until nothing changes
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < vm->num_instruct; i ++) {
+            for (int j = 0; j < num_callees[i] && memo->eligible[i]; j ++) {
+                if (!memo->eligible[callees[i][j]]) {
+                    memo->eligible[i] = 0;
+                    changed = 1;
+                }
+            }
+        }
+    }
+    return memo;
+}
+
+static void observe_read(struct memo *memo, struct vm *vm, int loc) {
+    /*
+     * Records a read of 'loc', adding it to the read set unless the call has
+     * already written it
+     */
+
+    if (memo->write_gen[loc] == memo->generation) {
+        // Reading a return address slot pushed by the memoized CAL ties the
+        // result to the call site
+        int slot = loc - memo->caller_fp - SYM_BUF;
+        if (loc < RAM_LIMIT && (slot == 0 || slot == 1) &&
+            (memo->pending.site_slots & (1 << slot))) {
+            memo->site_read = 1;
+        }
+        return;
+    }
+    if (memo->read_gen[loc] == memo->generation) {
+        return;
+    }
+    memo->read_gen[loc] = memo->generation;
+    struct memo_entry *entry = &memo->pending;
+    entry->read_loc[entry->num_reads] = loc;
+    entry->read_val[entry->num_reads] = load(vm, loc);
+    entry->num_reads ++;
+}
+
+static void observe_write(struct memo *memo, int loc) {
+    /*
+     * Records a write to 'loc', adding it to the write set
+     */
+
+    // Where the call returns to is checked in memo_after() instead
+    if (loc == REG_LOC(FUNC_PTR) || loc == REG_LOC(PROG_CTR)) {
+        return;
+    }
+    int slot = loc - memo->caller_fp - SYM_BUF;
+    if (loc < RAM_LIMIT && (slot == 0 || slot == 1)) {
+        memo->pending.site_slots &= ~(1 << slot);
+    }
+    if (memo->write_gen[loc] == memo->generation) {
+        return;
+    }
+    memo->write_gen[loc] = memo->generation;
+    struct memo_entry *entry = &memo->pending;
+    entry->write_loc[entry->num_writes] = loc;
+    entry->num_writes ++;
+}
+
+static void observe_source(struct memo *memo, struct vm *vm,
+                           struct instruction *instruct, int arg) {
+    /*
+     * Records locations read to fetch the value of argument 'arg'
+     */
+
+    int address = vm->reg[FRAME_PTR] + instruct->val[arg];
+    switch (instruct->type[arg]) {
+        case VAL:
+            break;
+        case REG:
+            observe_read(memo, vm, REG_LOC(instruct->val[arg]));
+            break;
+        case STK:
+            if (address < RAM_LIMIT) {
+                observe_read(memo, vm, address);
+            }
+            break;
+        case PTR:
+            if (address < RAM_LIMIT) {
+                observe_read(memo, vm, address);
+                observe_read(memo, vm, vm->ram[address]);
+            }
+            break;
+    }
+}
+
+static void observe_destination(struct memo *memo, struct vm *vm,
+                                struct instruction *instruct, int arg) {
+    /*
+     * Records locations read and written to store into argument 'arg'
+     */
+
+    int address = vm->reg[FRAME_PTR] + instruct->val[arg];
+    switch (instruct->type[arg]) {
+        case VAL:
+            break;
+        case REG:
+            observe_write(memo, REG_LOC(instruct->val[arg]));
+            break;
+        case STK:
+            if (address < RAM_LIMIT) {
+                observe_write(memo, address);
+            }
+            break;
+        case PTR:
+            if (address < RAM_LIMIT) {
+                observe_read(memo, vm, address);
+                observe_write(memo, vm->ram[address]);
+            }
+            break;
+    }
+}
+
+static void observe(struct memo *memo, struct vm *vm,
+                    struct instruction *instruct) {
+    /*
+     * Records locations 'instruct' will read and write, before it executes
+     */
+
+    uint8_t frame = vm->reg[FRAME_PTR];
+    switch (instruct->operation) {
+        case MOV:
+            observe_source(memo, vm, instruct, 0);
+            observe_destination(memo, vm, instruct, 1);
+            break;
+        case REF:
+            if (instruct->type[0] == PTR) {
+                observe_source(memo, vm, instruct, 0);
+            }
+            observe_destination(memo, vm, instruct, 1);
+            break;
+        case ADD:
+        case NOT:
+        case EQU:
+            observe_source(memo, vm, instruct, 0);
+            observe_source(memo, vm, instruct, instruct->num_args - 1);
+            observe_destination(memo, vm, instruct, instruct->num_args - 1);
+            break;
+        case CAL:
+            if (frame + SYM_BUF + RET_OFFSET < RAM_LIMIT) {
+                observe_write(memo, REG_LOC(FRAME_PTR));
+                observe_write(memo, REG_LOC(STK_PTR));
+                observe_write(memo, frame + SYM_BUF);
+                observe_write(memo, frame + SYM_BUF + 1);
+            }
+            break;
+        case RET:
+            // The memoized call's own RET is checked in memo_after()
+            if (frame != (uint8_t) (memo->caller_fp + SYM_BUF + RET_OFFSET)) {
+                observe_read(memo, vm, (uint8_t) (frame - 1));
+                observe_read(memo, vm, (uint8_t) (frame - 2));
+            }
+            observe_write(memo, REG_LOC(FRAME_PTR));
+            observe_write(memo, REG_LOC(STK_PTR));
+            break;
+        case PRINT:
+            break;
+    }
+}
+
+static int matches(struct vm *vm, struct memo_entry *entry) {
+    /*
+     * Returns 1 if every location in the read set of 'entry' holds the value
+     * it held when the entry was recorded
+     */
+
+    for (int i = 0; i < entry->num_reads; i ++) {
+        if (load(vm, entry->read_loc[i]) != entry->read_val[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void apply(struct vm *vm, struct memo_entry *entry) {
+    /*
+     * Performs the effects of the call recorded in 'entry' in place of the
+     * CAL currently being executed
+     */
+
+    uint8_t frame = vm->reg[FRAME_PTR];
+    if (entry->site_slots & 1) {
+        vm->ram[frame + SYM_BUF] = vm->reg[FUNC_PTR];
+    }
+    if (entry->site_slots & 2) {
+        vm->ram[frame + SYM_BUF + 1] = vm->reg[PROG_CTR] + 1;
+    }
+    for (int i = 0; i < entry->num_writes; i ++) {
+        store(vm, entry->write_loc[i], entry->write_val[i]);
+    }
+    increment_pc(vm);
+}
+
+static void start_recording(struct memo *memo, struct vm *vm, int func,
+                            struct instruction *instruct) {
+    /*
+     * Begins recording the call to 'func' made by the CAL about to execute
+     */
+
+    memo->generation ++;
+    if (memo->generation == 0) {
+        memset(memo->read_gen, 0, sizeof(memo->read_gen));
+        memset(memo->write_gen, 0, sizeof(memo->write_gen));
+        memo->generation = 1;
+    }
+    memo->recording = 1;
+    memo->func = func;
+    memo->caller_func = vm->reg[FUNC_PTR];
+    memo->caller_pc = vm->reg[PROG_CTR];
+    memo->caller_fp = vm->reg[FRAME_PTR];
+    memo->site_read = 0;
+    memo->start_executed = vm->executed - 1;
+    memo->pending.num_reads = 0;
+    memo->pending.num_writes = 0;
+
+    // Every address the callee uses is relative to the caller's frame
+    observe_read(memo, vm, REG_LOC(FRAME_PTR));
+    observe(memo, vm, instruct);
+    memo->pending.site_slots = 3;
+}
+
+int memo_before(struct vm *vm, struct instruction *instruct, uint64_t limit) {
+    /*
+     * Called before each instruction executes. Replaces a CAL with the
+     * recorded effects of an identical earlier call if there is one, or
+     * starts recording it
+     * Returns 1 if the CAL was replaced and must not be executed
+     */
+
+    struct memo *memo = vm->memo;
+    if (memo->recording) {
+        // A return address rewritten at run time can still lead to code that
+        // prints or is otherwise unsafe to replay, so the call is dropped
+        if (instruct->operation == PRINT ||
+            !memo->eligible[vm->reg[FUNC_PTR]]) {
+            memo->recording = 0;
+            return 0;
+        }
+        observe(memo, vm, instruct);
+        return 0;
+    }
+    if (instruct->operation != CAL || instruct->type[0] != VAL) {
+        return 0;
+    }
+    int func = get_func(vm, instruct->val[0]);
+    if (func == NO_VAL || !memo->eligible[func]) {
+        return 0;
+    }
+
+    for (int i = 0; i < memo->num_entries[func]; i ++) {
+        struct memo_entry *entry = &memo->entries[func][i];
+        if (vm->executed - 1 + entry->instructions <= limit &&
+            matches(vm, entry)) {
+            apply(vm, entry);
+            vm->executed += entry->instructions - 1;
+            memo->hits ++;
+            memo->skipped += entry->instructions;
+            return 1;
+        }
+    }
+
+    memo->misses ++;
+    if (vm->reg[FRAME_PTR] + SYM_BUF + RET_OFFSET < RAM_LIMIT) {
+        start_recording(memo, vm, func, instruct);
+    }
+    return 0;
+}
+
+void memo_after(struct vm *vm, struct instruction *instruct) {
+    /*
+     * Called after each instruction executes. Stores the recorded call once
+     * it has returned to the caller
+     */
+
+    struct memo *memo = vm->memo;
+    if (!memo->recording || instruct->operation != RET ||
+        vm->reg[FRAME_PTR] != memo->caller_fp) {
+        return;
+    }
+    memo->recording = 0;
+
+    // Calls that overwrote their own return address are not reused, even if
+    // they happened to return to the same place, since apply() always resumes
+    // after the CAL
+    if (memo->pending.site_slots != 3 ||
+        vm->reg[FUNC_PTR] != memo->caller_func ||
+        vm->reg[PROG_CTR] != (uint8_t) (memo->caller_pc + 1)) {
+        return;
+    }
+
+    struct memo_entry *pending = &memo->pending;
+    if (memo->site_read) {
+        pending->read_loc[pending->num_reads] = REG_LOC(FUNC_PTR);
+        pending->read_val[pending->num_reads ++] = memo->caller_func;
+        pending->read_loc[pending->num_reads] = REG_LOC(PROG_CTR);
+        pending->read_val[pending->num_reads ++] = memo->caller_pc;
+    }
+
+    int index = memo->next_entry[memo->func];
+    memo->next_entry[memo->func] = (index + 1) % MEMO_ENTRIES;
+    if (memo->num_entries[memo->func] < MEMO_ENTRIES) {
+        memo->num_entries[memo->func] ++;
+    }
+    struct memo_entry *entry = &memo->entries[memo->func][index];
+    entry->num_reads = pending->num_reads;
+    memcpy(entry->read_loc, pending->read_loc,
+           pending->num_reads * sizeof(entry->read_loc[0]));
+    memcpy(entry->read_val, pending->read_val, pending->num_reads);
+
+    // Write set holds final values, leaving out slots rebuilt by apply()
+    entry->num_writes = 0;
+    entry->site_slots = pending->site_slots;
+    for (int i = 0; i < pending->num_writes; i ++) {
+        int loc = pending->write_loc[i];
+        int slot = loc - memo->caller_fp - SYM_BUF;
+        if (loc < RAM_LIMIT && (slot == 0 || slot == 1) &&
+            (entry->site_slots & (1 << slot))) {
+            continue;
+        }
+        entry->write_loc[entry->num_writes] = loc;
+        entry->write_val[entry->num_writes] = load(vm, loc);
+        entry->num_writes ++;
+    }
+    entry->instructions = vm->executed - memo->start_executed;
+    memo->recorded ++;
+}
+
+void memo_report(FILE *out, struct memo *memo) {
+    /*
+     * Prints hit and miss counts of memoized calls
+     */
+
+    uint64_t lookups = memo->hits + memo->misses;
+    fprintf(out, "MEMO hits %llu misses %llu (%.1f%% hit rate), %llu calls "
+            "recorded, %llu instructions skipped\n",
+            (unsigned long long) memo->hits,
+            (unsigned long long) memo->misses,
+            lookups > 0 ? 100.0 * memo->hits / lookups : 0.0,
+            (unsigned long long) memo->recorded,
+            (unsigned long long) memo->skipped);
+}
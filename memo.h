@@ -0,0 +1,60 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include "vm.h"
+
+#define MEMO_ENTRIES 16                     // Cached calls kept per function
+#define MEMO_LOCS (RAM_LIMIT + REG_LIMIT)   // RAM addresses, then registers
+
+/*
+ * Effect of one completed call: the locations it read before writing them,
+ * with their values at the CAL, and the final value of every location it
+ * wrote. The two return address slots of the call's frame are left out of
+ * the write set and rewritten from the caller's registers, so an entry can
+ * be reused from any call site unless the callee read those slots
+ */
+struct memo_entry {
+    uint16_t num_reads;
+    uint16_t num_writes;
+    uint8_t site_slots;         // Bit 0: function slot, bit 1: PC slot
+    uint64_t instructions;
+    uint16_t read_loc[MEMO_LOCS];
+    uint8_t read_val[MEMO_LOCS];
+    uint16_t write_loc[MEMO_LOCS];
+    uint8_t write_val[MEMO_LOCS];
+};
+
+struct memo {
+    uint8_t eligible[MAX_FUNC];
+    struct memo_entry entries[MAX_FUNC][MEMO_ENTRIES];
+    uint8_t num_entries[MAX_FUNC];
+    uint8_t next_entry[MAX_FUNC];
+
+    // State of the call currently being recorded, at most one at a time
+    uint8_t recording;
+    uint8_t func;
+    uint8_t caller_func;
+    uint8_t caller_pc;
+    uint8_t caller_fp;
+    uint8_t site_read;
+    uint64_t start_executed;
+    uint32_t generation;
+    uint32_t read_gen[MEMO_LOCS];
+    uint32_t write_gen[MEMO_LOCS];
+    struct memo_entry pending;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t recorded;
+    uint64_t skipped;
+};
+
+struct memo *memo_create(struct vm *vm);
+
+int memo_before(struct vm *vm, struct instruction *instruct, uint64_t limit);
+
+void memo_after(struct vm *vm, struct instruction *instruct);
+
+void memo_report(FILE *out, struct memo *memo);
+
+#endif
@@ -0,0 +1,144 @@
+#include <string.h>
+#include "objdump.h"
+
+const char *opcode_names[] = {
+    [MOV] = "MOV",
+    [CAL] = "CAL",
+    [RET] = "RET",
+    [REF] = "REF",
+    [ADD] = "ADD",
+    [PRINT] = "PRINT",
+    [NOT] = "NOT",
+    [EQU] = "EQU"
+};
+
+// Each type name carries the space that separates it from the previous token
+const char *type_names[] = {
+    [VAL] = " VAL",
+    [REG] = " REG",
+    [STK] = " STK",
+    [PTR] = " PTR"
+};
+
+char map_symbol(int index) {
+    /*
+     * Maps symbols to letters in order of appearance
+     */ 
+
+    static const char symbols[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I',
+                                   'J', 'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R',
+                                   'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a',
+                                   'b', 'c', 'd', 'e', 'f'};
+    return symbols[index];
+}
+
+static char *append_str(char *dst, const char *src) {
+    /*
+     * Copies 'src' to 'dst' without its terminator
+     * Returns position after the copied characters
+     */
+
+    while (*src != '\0') {
+        *dst++ = *src++;
+    }
+    return dst;
+}
+
+static char *append_digits(char *dst, int value) {
+    /*
+     * Writes the decimal digits of 'value' (0 to 255)
+     * Returns position after the written characters
+     */
+
+    if (value >= 100) {
+        *dst++ = '0' + value / 100;
+    }
+    if (value >= 10) {
+        *dst++ = '0' + (value / 10) % 10;
+    }
+    *dst++ = '0' + value % 10;
+    return dst;
+}
+
+static char *append_num(char *dst, int value) {
+    /*
+     * Writes ' ' followed by the decimal digits of 'value' (0 to 255)
+     * Returns position after the written characters
+     */
+
+    *dst++ = ' ';
+    return append_digits(dst, value);
+}
+
+int format_instruction(char *buf, struct instruction *instruct,
+                       char symbol_map[], int *num_symbols) {
+    /*
+     * Writes the objdump text of 'instruct' (e.g. "MOV STK A VAL 0") into
+     * 'buf', which must hold INSTRUCT_BUF characters. 'symbol_map' maps each
+     * stack symbol to its letter, or 0 if it has not been encountered yet
+     * Offsets past the last symbol only occur in inlined code, which uses the
+     * callee's frame directly, and are shown as '#' and the offset
+     * Returns number of characters written, excluding the terminator
+     */
+
+    char *end = append_str(buf, opcode_names[instruct->operation]);
+
+    // Loops through instruction arguments
+    for (int j = instruct->num_args - 1; j >= 0 ; j --) {
+        enum val_type type = instruct->type[j];
+        int value = instruct->val[j];
+        end = append_str(end, type_names[type]);
+
+        if (((type == STK) || (type == PTR)) && value >= SYM_BUF) {
+            end = append_str(end, " #");
+            end = append_digits(end, value);
+        } else if ((type == STK) || (type == PTR)) {
+            // If symbol has not been encountered yet, give it the next letter
+            if (symbol_map[value] == 0) {
+                symbol_map[value] = map_symbol(*num_symbols);
+                (*num_symbols) ++;
+            }
+            *end++ = ' ';
+            *end++ = symbol_map[value];
+        } else {
+            end = append_num(end, value);
+        }
+    }
+    *end = '\0';
+    return end - buf;
+}
+
+int format_func(char *buf, struct function *func) {
+    /*
+     * Writes function label and commands into 'buf', which must hold
+     * FUNC_BUF characters
+     * Returns number of characters written, excluding the terminator
+     */
+
+    char symbol_map[SYM_BUF] = {0};
+    int num_symbols = 0;
+
+    char *end = append_str(buf, "FUNC LABEL");
+    end = append_num(end, func->label);
+    *end++ = '\n';
+
+    // Loops through each instruction in the function
+    for (int i = 0; i < func->num_instruct; i ++) {
+        end = append_str(end, "    ");
+        end += format_instruction(end, &func->instructions[i], symbol_map,
+                                  &num_symbols);
+        *end++ = '\n';
+    }
+    *end = '\0';
+    return end - buf;
+}
+
+void print_func(struct function *func) {
+    /*
+     * Prints function labels and commands
+     */ 
+
+    char buf[FUNC_BUF];
+    int len = format_func(buf, func);
+    fwrite(buf, 1, len, stdout);
+}
@@ -4,8 +4,20 @@
 #include "objects.h"
 #include "parser.h"
 
-int find_symbol(char array[], int size, char target);
+#define INSTRUCT_BUF 32 // Longest line is e.g. "PRINT VAL 255" / "REF STK A PTR B"
+#define FUNC_BUF 1024   // Label line plus 32 indented instruction lines
+
+extern const char *opcode_names[];
+
+extern const char *type_names[];
+
+char map_symbol(int index);
+
+int format_instruction(char *buf, struct instruction *instruct,
+                       char symbol_map[], int *num_symbols);
+
+int format_func(char *buf, struct function *func);
 
 void print_func(struct function *func);
 
-#endif
\ No newline at end of file
+#endif
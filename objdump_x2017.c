@@ -1,146 +1,223 @@
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "objdump.h"
+#include "inline.h"
 
-int find_symbol(char array[], int size, char target) {
+/*
+ * One input file of a batch. Workers fill in 'output' (and 'error' for
+ * messages that belong on stderr) and set 'done'; the main thread prints jobs
+ * in command line order as soon as each one is finished
+ */
+struct job {
+    const char *path;
+    char *output;
+    int len;
+    char error[128];
+    int status;
+    int done;
+};
+
+struct batch {
+    struct job *jobs;
+    int num_jobs;
+    int next;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+};
+
+// Threshold that programs are inlined with before printing, -1 if they are not
+static int inline_threshold = -1;
+
+void disassemble(struct job *job) {
     /*
-     * Finds and returns index of 'target' in 'array'
-     * Returns -1 if 'target' cannot be found
-     */ 
+     * Reads and parses the file at 'job->path' and renders its functions into
+     * a newly allocated 'job->output'
+     */
 
-    for (int i = 0; i < size; i ++) {
-        if (array[i] == target) {
-            return i;
-        }
+    job->output = NULL;
+    job->len = 0;
+    job->status = 1;
+
+    FILE *bin_file = fopen(job->path, "rb");
+    if (bin_file == NULL) {
+        snprintf(job->error, sizeof(job->error),
+                 "Error: File could not be opened: %s\n", strerror(errno));
+        return;
     }
-    return -1;
-}
 
-char map_symbol(int index) {
-    /*
-     * Maps symbols to letters in order of appearance
-     */ 
+    fseek(bin_file, 0, SEEK_END);
+    int num_bytes = ftell(bin_file);
+    if (num_bytes == 0) {
+        fclose(bin_file);
+        job->output = strdup("Error: File cannot be empty\n");
+        job->len = strlen(job->output);
+        return;
+    }
+    if (num_bytes > BUF) {
+        fclose(bin_file);
+        job->output = strdup("Error: File is too large\n");
+        job->len = strlen(job->output);
+        return;
+    }
+    fseek(bin_file, 0, SEEK_SET);
+
+    BYTE f_bits[BUF] = {0};
+    fread(f_bits, 1, num_bytes, bin_file);
+    fclose(bin_file);
 
-    char symbols[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 
-                      'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V',
-                      'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f'};
-    return symbols[index];
+    struct function func_array[8] = {0};
+    struct function *func_ptr = func_array;
+    BYTE *bit_ptr = &f_bits[num_bytes - 1];
+    int num_func = parse(func_ptr, MAX_FUNC, bit_ptr, num_bytes);
+    if (num_func < 0) {
+        char message[128];
+        snprintf(message, sizeof(message), "Error: %s\n",
+                 parse_error(num_func));
+        job->output = strdup(message);
+        job->len = strlen(job->output);
+        return;
+    }
+    if (inline_threshold >= 0) {
+        inline_leaves(func_array, num_func, inline_threshold);
+    }
+
+    job->output = malloc(num_func * FUNC_BUF + 1);
+    for (int i = num_func; i > 0; i --) {
+        job->len += format_func(job->output + job->len, &func_array[i - 1]);
+    }
+    job->status = 0;
 }
 
-void print_func(struct function *func) {
+void *worker(void *arg) {
     /*
-     * Prints function labels and commands
-     */ 
+     * Takes jobs from the batch until none are left
+     */
 
-    printf("FUNC LABEL %d\n", func->label);
-    char symbol_arr[SYM_BUF] = {0};
-    int arr_size = 0;
+    struct batch *batch = arg;
+    while (1) {
+        int index = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+        if (index >= batch->num_jobs) {
+            return NULL;
+        }
+        struct job *job = &batch->jobs[index];
+        disassemble(job);
 
-    // Loops through each instruction in the function
-    for (int i = 0; i < func->num_instruct; i ++) {
-        enum opcode operation = func->instructions[i].operation;
-        char const *print_type;
+        pthread_mutex_lock(&batch->lock);
+        job->done = 1;
+        pthread_cond_broadcast(&batch->finished);
+        pthread_mutex_unlock(&batch->lock);
+    }
+}
 
-        switch (operation) {
-            case MOV:
-                print_type = "MOV";
-                break;
-            case CAL:
-                print_type = "CAL";
-                break;
-            case RET:
-                print_type = "RET";
-                break;
-            case REF:
-                print_type = "REF";
-                break;
-            case ADD:
-                print_type = "ADD";
-                break;
-            case PRINT:
-                print_type = "PRINT";
-                break;
-            case NOT:
-                print_type = "NOT";
-                break;
-            case EQU:
-                print_type = "EQU";
+int main(int argc, char **argv) {
+    // Handles command line options
+    long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    struct option options[] = {
+        {"inline", no_argument, NULL, 'i'},
+        {"inline-threshold", required_argument, NULL, 'l'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "j:i", options, NULL)) != -1) {
+        switch (opt) {
+            case 'j': {
+                char *end;
+                errno = 0;
+                num_threads = strtol(optarg, &end, 10);
+                if (!isdigit((unsigned char) optarg[0]) || *end != '\0' ||
+                    errno == ERANGE || num_threads < 1) {
+                    printf("Error: Number of threads must be at least 1\n");
+                    return 1;
+                }
                 break;
-        }
-        printf("    %s", print_type);
-        
-        // Loops through instruction arguments
-        for (int j = func->instructions[i].num_args - 1; j >= 0 ; j --) {
-            enum val_type type = func->instructions[i].type[j];
-            char const *print_type;
-
-            switch (type) {
-                case VAL:
-                    print_type = "VAL";
-                    break;
-                case REG:
-                    print_type = "REG";
-                    break;
-                case STK:
-                    print_type = "STK";
-                    break;
-                case PTR:
-                    print_type = "PTR";
-                    break;
             }
-            printf(" %s", print_type);
-
-            int value = func->instructions[i].val[j];
-            if ((type == STK) || (type == PTR)) {
-                int index = find_symbol(symbol_arr, arr_size, value);
-                
-                // If symbol has not been encountered yet, record it in symbol
-                // array
-                if (index == -1) {
-                    symbol_arr[arr_size] = value;
-                    index = arr_size;
-                    arr_size ++;
+            case 'i':
+                inline_threshold = INLINE_DEFAULT_THRESHOLD;
+                break;
+            case 'l':
+                inline_threshold = parse_inline_threshold(optarg);
+                if (inline_threshold == -1) {
+                    printf("Error: Inline threshold must be a number from 0 "
+                           "to %d\n", INLINE_MAX_THRESHOLD);
+                    return 1;
                 }
-                char symbol = map_symbol(index);
-                printf(" %c", symbol);
-            } else {
-                printf(" %d", value);
-            }
+                break;
+            default:
+                return 1;
         }
-        printf("\n");
     }
-}
 
-int main(int argc, char **argv) {
-    // Handles file errors and parses file
-    if (argc != 2) {
+    if (argc - optind < 1) {
         printf("Error: Please provide <filename> as command line argument\n");
         return 1;
     }
 
-    FILE *bin_file = fopen(argv[1], "rb");
-    if (bin_file == NULL) {
-        perror("Error: File could not be opened");
-        return 1;
+    struct batch batch;
+    batch.num_jobs = argc - optind;
+    batch.jobs = calloc(batch.num_jobs, sizeof(struct job));
+    batch.next = 0;
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.finished, NULL);
+    for (int i = 0; i < batch.num_jobs; i ++) {
+        batch.jobs[i].path = argv[optind + i];
     }
 
-    fseek(bin_file, 0, SEEK_END);
-    int num_bytes = ftell(bin_file);
-    if (num_bytes == 0) {
-        printf("Error: File cannot be empty\n");
-        return 1;
+    // A single file is disassembled directly, without starting any threads
+    if (num_threads > batch.num_jobs) {
+        num_threads = batch.num_jobs;
+    }
+    if (num_threads < 1 || batch.num_jobs == 1) {
+        num_threads = 0;
+    }
+    pthread_t *threads = calloc(num_threads + 1, sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; i < num_threads; i ++) {
+        if (pthread_create(&threads[started], NULL, worker, &batch) == 0) {
+            started ++;
+        }
     }
-    fseek(bin_file, 0, SEEK_SET);
 
-    BYTE f_bits[BUF] = {0};
-    fread(f_bits, 1, num_bytes, bin_file);
-    fclose(bin_file);
+    // Any threads that did start take every job between them; without any,
+    // the main thread does the work itself
+    if (started == 0) {
+        worker(&batch);
+    }
 
-    struct function func_array[8] = {0};
-    struct function *func_ptr = func_array;
-    BYTE *bit_ptr = &f_bits[num_bytes - 1];
-    int num_func = parse(func_ptr, bit_ptr, num_bytes);
-    
-    for (int i = num_func; i > 0; i --) {
-        print_func(&func_array[i - 1]);
+    // Prints each file's output in order, headed by its name in batch mode
+    int status = 0;
+    for (int i = 0; i < batch.num_jobs; i ++) {
+        struct job *job = &batch.jobs[i];
+        pthread_mutex_lock(&batch.lock);
+        while (!job->done) {
+            pthread_cond_wait(&batch.finished, &batch.lock);
+        }
+        pthread_mutex_unlock(&batch.lock);
+
+        if (batch.num_jobs > 1) {
+            printf("%s:\n", job->path);
+        }
+        if (job->output != NULL) {
+            fwrite(job->output, 1, job->len, stdout);
+            free(job->output);
+        }
+        if (job->error[0] != '\0') {
+            fflush(stdout);
+            fputs(job->error, stderr);
+        }
+        status |= job->status;
+    }
+
+    for (int i = 0; i < started; i ++) {
+        pthread_join(threads[i], NULL);
     }
-    return 0;
+    free(threads);
+    free(batch.jobs);
+    pthread_mutex_destroy(&batch.lock);
+    pthread_cond_destroy(&batch.finished);
+    return status;
 }
@@ -0,0 +1,459 @@
+#include <dirent.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include "objdump.h"
+#include "vm.h"
+
+#define NUM_OPS 8
+#define NUM_TYPES 5         // Argument types plus NO_ARG for missing ones
+#define NO_ARG 4
+#define NO_OP -1          // No instruction before the start of a sequence
+#define MAX_DEPTH 8         // Frames that fit in RAM, counting main()
+#define RECURSIVE (MAX_FUNC + 1)
+#define DEFAULT_BUDGET 1000000
+
+/*
+ * Opcode sequence and argument pattern counts. Counted once per instruction
+ * for the static profile, where sequences are neighbours within a function,
+ * and once per execution for the dynamic profile, where sequences are
+ * instructions executed one after another, across calls and returns
+ */
+struct profile {
+    uint64_t instructions;
+    uint64_t op[NUM_OPS];
+    uint64_t bigram[NUM_OPS][NUM_OPS];
+    uint64_t trigram[NUM_OPS][NUM_OPS][NUM_OPS];
+    uint64_t pattern[NUM_OPS][NUM_TYPES][NUM_TYPES];
+};
+
+struct stats {
+    uint64_t files;
+    uint64_t parsed;
+    uint64_t completed;
+    uint64_t failed;
+    struct profile static_prof;
+    struct profile dynamic_prof;
+    uint64_t func_size[33];
+    uint64_t slots_per_func[SYM_BUF + 1];
+    uint64_t slot_index[SYM_BUF];
+    uint64_t call_depth[RECURSIVE + 1];   // Static depth from main()
+    uint64_t max_depth[MAX_DEPTH + 1];    // Deepest frame reached while running
+};
+
+struct scan {
+    char **paths;
+    int num_paths;
+    int next;
+    int dynamic;
+    uint64_t budget;
+};
+
+void count_instruction(struct profile *prof, struct instruction *instruct,
+                       int first, int prev) {
+    /*
+     * Adds 'instruct', and the bigram and trigram ending at it after opcodes
+     * 'first' and 'prev' (NO_OP where there are none), to 'prof'
+     */
+
+    int op = instruct->operation;
+    int types[2] = {NO_ARG, NO_ARG};
+    for (int i = 0; i < instruct->num_args; i ++) {
+        types[i] = instruct->type[i];
+    }
+
+    prof->instructions ++;
+    prof->op[op] ++;
+    prof->pattern[op][types[1]][types[0]] ++;
+    if (prev != NO_OP) {
+        prof->bigram[prev][op] ++;
+        if (first != NO_OP) {
+            prof->trigram[first][prev][op] ++;
+        }
+    }
+}
+
+int call_depth(struct vm *vm, int index, uint8_t on_path[]) {
+    /*
+     * Returns maximum number of frames live at once when calling function
+     * 'index' (itself included), or RECURSIVE if it can reach itself
+     */
+
+    if (on_path[index]) {
+        return RECURSIVE;
+    }
+    on_path[index] = 1;
+
+    int deepest = 0;
+    struct function *func = &vm->code_mem[index];
+    for (int i = 0; i < func->num_instruct; i ++) {
+        struct instruction *instruct = &func->instructions[i];
+        if (instruct->operation != CAL || instruct->type[0] != VAL) {
+            continue;
+        }
+        int callee = get_func(vm, instruct->val[0]);
+        if (callee == NO_VAL) {
+            continue;
+        }
+        int depth = call_depth(vm, callee, on_path);
+        if (depth == RECURSIVE) {
+            deepest = RECURSIVE;
+            break;
+        }
+        if (depth > deepest) {
+            deepest = depth;
+        }
+    }
+
+    on_path[index] = 0;
+    return deepest == RECURSIVE ? RECURSIVE : deepest + 1;
+}
+
+void scan_static(struct stats *stats, struct vm *vm) {
+    /*
+     * Counts instruction sequences, function sizes and stack slot usage of
+     * every parsed function
+     */
+
+    for (int i = 0; i < vm->num_instruct; i ++) {
+        struct function *func = &vm->code_mem[i];
+        uint8_t used[SYM_BUF] = {0};
+        int num_slots = 0;
+
+        stats->func_size[func->num_instruct] ++;
+        int first = NO_OP;
+        int prev = NO_OP;
+        for (int pc = 0; pc < func->num_instruct; pc ++) {
+            struct instruction *instruct = &func->instructions[pc];
+            count_instruction(&stats->static_prof, instruct, first, prev);
+            first = prev;
+            prev = instruct->operation;
+
+            for (int j = 0; j < instruct->num_args; j ++) {
+                if (instruct->type[j] != STK && instruct->type[j] != PTR) {
+                    continue;
+                }
+                stats->slot_index[instruct->val[j]] ++;
+                if (!used[instruct->val[j]]) {
+                    used[instruct->val[j]] = 1;
+                    num_slots ++;
+                }
+            }
+        }
+        stats->slots_per_func[num_slots] ++;
+    }
+}
+
+void scan_dynamic(struct stats *stats, struct vm *vm, uint64_t budget) {
+    /*
+     * Runs program one instruction at a time, counting each instruction and
+     * the sequence of instructions executed up to it
+     */
+
+    int first = NO_OP;
+    int prev = NO_OP;
+    int deepest = 0;
+
+    int status = VM_LIMIT;
+    while (status == VM_LIMIT && vm->executed < budget) {
+        struct function *func = &vm->code_mem[vm->reg[FUNC_PTR]];
+        struct instruction *instruct = &func->instructions[vm->reg[PROG_CTR]];
+        uint64_t executed = vm->executed;
+
+        // Any status can follow an executed instruction, e.g. VM_OK after
+        // the last one before main()'s RET
+        status = vm_run(vm, executed + 1, NULL);
+        if (vm->executed > executed) {
+            count_instruction(&stats->dynamic_prof, instruct, first, prev);
+            first = prev;
+            prev = instruct->operation;
+        }
+
+        int depth = vm->reg[FRAME_PTR] / (SYM_BUF + RET_OFFSET) + 1;
+        if (depth > deepest) {
+            deepest = depth;
+        }
+    }
+
+    if (status == VM_OK) {
+        stats->completed ++;
+    } else {
+        stats->failed ++;
+    }
+    stats->max_depth[deepest < MAX_DEPTH ? deepest : MAX_DEPTH] ++;
+}
+
+void scan_file(struct stats *stats, const char *path, int dynamic,
+               uint64_t budget) {
+    /*
+     * Parses the file at 'path' and adds its statistics to 'stats'
+     */
+
+    stats->files ++;
+    FILE *bin_file = fopen(path, "rb");
+    if (bin_file == NULL) {
+        return;
+    }
+    BYTE f_bits[BUF] = {0};
+    int num_bytes = fread(f_bits, 1, BUF, bin_file);
+    int extra = fgetc(bin_file);
+    fclose(bin_file);
+    if (num_bytes == 0 || extra != EOF) {
+        return;
+    }
+
+    static __thread struct vm vm;
+    BYTE *bit_ptr = &f_bits[num_bytes - 1];
+    vm.num_instruct = parse(vm.code_mem, MAX_FUNC, bit_ptr, num_bytes);
+    if (vm.num_instruct < 0) {
+        return;
+    }
+    stats->parsed ++;
+    scan_static(stats, &vm);
+
+    int main_address = get_func(&vm, 0);
+    if (main_address == NO_VAL) {
+        return;
+    }
+    uint8_t on_path[MAX_FUNC] = {0};
+    stats->call_depth[call_depth(&vm, main_address, on_path)] ++;
+
+    if (dynamic) {
+        vm_init(&vm, main_address);
+        vm.out = NULL;
+        scan_dynamic(stats, &vm, budget);
+    }
+}
+
+void *worker(void *arg) {
+    /*
+     * Scans files until none are left
+     * Returns statistics gathered by this thread
+     */
+
+    struct scan *scan = arg;
+    struct stats *stats = calloc(1, sizeof(struct stats));
+    while (1) {
+        int index = __atomic_fetch_add(&scan->next, 1, __ATOMIC_RELAXED);
+        if (index >= scan->num_paths) {
+            return stats;
+        }
+        scan_file(stats, scan->paths[index], scan->dynamic, scan->budget);
+    }
+}
+
+void merge(uint64_t *total, uint64_t *part, size_t size) {
+    /*
+     * Adds counters in 'part' to 'total'; 'size' is in bytes
+     */
+
+    for (size_t i = 0; i < size / sizeof(uint64_t); i ++) {
+        total[i] += part[i];
+    }
+}
+
+void print_counts(const char *name, char keys[][24], uint64_t counts[],
+                  int num, int last) {
+    /*
+     * Prints non-zero 'counts' as a JSON object member, largest first
+     */
+
+    uint8_t printed[NUM_OPS * NUM_OPS * NUM_OPS] = {0};
+    printf("    \"%s\": {", name);
+    int first = 1;
+    while (1) {
+        int best = -1;
+        for (int i = 0; i < num; i ++) {
+            if (!printed[i] && counts[i] > 0 &&
+                (best == -1 || counts[i] > counts[best])) {
+                best = i;
+            }
+        }
+        if (best == -1) {
+            break;
+        }
+        printed[best] = 1;
+        printf("%s\n      \"%s\": %llu", first ? "" : ",", keys[best],
+               (unsigned long long) counts[best]);
+        first = 0;
+    }
+    printf("%s}%s\n", first ? "" : "\n    ", last ? "" : ",");
+}
+
+void print_histogram(const char *name, uint64_t counts[], int num, int last) {
+    /*
+     * Prints 'counts' indexed by value as a JSON object member
+     */
+
+    static char keys[NUM_OPS * NUM_OPS * NUM_OPS][24];
+    for (int i = 0; i < num; i ++) {
+        snprintf(keys[i], sizeof(keys[i]), "%d", i);
+    }
+
+    printf("    \"%s\": {", name);
+    int first = 1;
+    for (int i = 0; i < num; i ++) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        printf("%s\"%s\": %llu", first ? "" : ", ", keys[i],
+               (unsigned long long) counts[i]);
+        first = 0;
+    }
+    printf("}%s\n", last ? "" : ",");
+}
+
+void print_profile(const char *name, struct profile *prof, int last_member) {
+    /*
+     * Prints opcode, n-gram and argument pattern counts as JSON members of
+     * an object 'name', without closing it unless 'last_member' is set
+     */
+
+    static char keys[NUM_OPS * NUM_OPS * NUM_OPS][24];
+    printf("  \"%s\": {\n", name);
+    printf("    \"instructions\": %llu,\n",
+           (unsigned long long) prof->instructions);
+
+    for (int i = 0; i < NUM_OPS; i ++) {
+        snprintf(keys[i], sizeof(keys[i]), "%s", opcode_names[i]);
+    }
+    print_counts("opcodes", keys, prof->op, NUM_OPS, 0);
+
+    for (int i = 0; i < NUM_OPS * NUM_OPS; i ++) {
+        snprintf(keys[i], sizeof(keys[i]), "%s %s",
+                 opcode_names[i / NUM_OPS], opcode_names[i % NUM_OPS]);
+    }
+    print_counts("bigrams", keys, &prof->bigram[0][0], NUM_OPS * NUM_OPS, 0);
+
+    for (int i = 0; i < NUM_OPS * NUM_OPS * NUM_OPS; i ++) {
+        snprintf(keys[i], sizeof(keys[i]), "%s %s %s",
+                 opcode_names[i / (NUM_OPS * NUM_OPS)],
+                 opcode_names[(i / NUM_OPS) % NUM_OPS],
+                 opcode_names[i % NUM_OPS]);
+    }
+    print_counts("trigrams", keys, &prof->trigram[0][0][0],
+                 NUM_OPS * NUM_OPS * NUM_OPS, 0);
+
+    // Keys list argument types in objdump order, e.g. "MOV STK VAL"
+    for (int i = 0; i < NUM_OPS * NUM_TYPES * NUM_TYPES; i ++) {
+        int first = (i / NUM_TYPES) % NUM_TYPES;
+        int second = i % NUM_TYPES;
+        snprintf(keys[i], sizeof(keys[i]), "%s%s%s",
+                 opcode_names[i / (NUM_TYPES * NUM_TYPES)],
+                 first == NO_ARG ? "" : type_names[first],
+                 second == NO_ARG ? "" : type_names[second]);
+    }
+    print_counts("operand_patterns", keys, &prof->pattern[0][0][0],
+                 NUM_OPS * NUM_TYPES * NUM_TYPES, last_member);
+}
+
+void add_path(char ***paths, int *num_paths, const char *path) {
+    /*
+     * Adds 'path', or every .x2017 file directly inside it if it is a
+     * directory, to 'paths'; any other path is added as a file, so one that
+     * cannot be read is counted as a file that did not parse
+     */
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        *paths = realloc(*paths, (*num_paths + 1) * sizeof(char *));
+        (*paths)[(*num_paths) ++] = strdup(path);
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len < 6 || strcmp(entry->d_name + len - 6, ".x2017") != 0) {
+            continue;
+        }
+        char *full = malloc(strlen(path) + len + 2);
+        sprintf(full, "%s/%s", path, entry->d_name);
+        *paths = realloc(*paths, (*num_paths + 1) * sizeof(char *));
+        (*paths)[(*num_paths) ++] = full;
+    }
+    closedir(dir);
+}
+
+int main(int argc, char **argv) {
+    // Handles command line options
+    struct scan scan = {0};
+    scan.budget = DEFAULT_BUDGET;
+    long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    struct option options[] = {
+        {"dynamic", no_argument, NULL, 'd'},
+        {"budget", required_argument, NULL, 'b'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "j:", options, NULL)) != -1) {
+        switch (opt) {
+            case 'j':
+                num_threads = strtol(optarg, NULL, 10);
+                break;
+            case 'd':
+                scan.dynamic = 1;
+                break;
+            case 'b':
+                scan.budget = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                return 1;
+        }
+    }
+    if (argc - optind < 1) {
+        printf("Error: Please provide <directory> as command line argument\n");
+        return 1;
+    }
+    for (int i = optind; i < argc; i ++) {
+        add_path(&scan.paths, &scan.num_paths, argv[i]);
+    }
+
+    // Each thread keeps its own counters, which are summed at the end
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    pthread_t *threads = calloc(num_threads, sizeof(pthread_t));
+    for (int i = 0; i < num_threads; i ++) {
+        pthread_create(&threads[i], NULL, worker, &scan);
+    }
+    struct stats *total = calloc(1, sizeof(struct stats));
+    for (int i = 0; i < num_threads; i ++) {
+        struct stats *part;
+        pthread_join(threads[i], (void **) &part);
+        merge((uint64_t *) total, (uint64_t *) part, sizeof(struct stats));
+        free(part);
+    }
+
+    printf("{\n");
+    printf("  \"files\": %llu,\n", (unsigned long long) total->files);
+    printf("  \"parsed\": %llu,\n", (unsigned long long) total->parsed);
+    print_profile("static", &total->static_prof, 0);
+    print_histogram("function_size", total->func_size, 33, 0);
+    print_histogram("stack_slots_per_function", total->slots_per_func,
+                    SYM_BUF + 1, 0);
+    print_histogram("stack_slot_index", total->slot_index, SYM_BUF, 0);
+    print_histogram("call_depth", total->call_depth, RECURSIVE, 0);
+    printf("    \"recursive\": %llu\n",
+           (unsigned long long) total->call_depth[RECURSIVE]);
+    printf("  }%s\n", scan.dynamic ? "," : "");
+    if (scan.dynamic) {
+        printf("  \"budget\": %llu,\n", (unsigned long long) scan.budget);
+        print_profile("dynamic", &total->dynamic_prof, 0);
+        print_histogram("max_call_depth", total->max_depth, MAX_DEPTH + 1, 0);
+        printf("    \"completed\": %llu,\n",
+               (unsigned long long) total->completed);
+        printf("    \"failed\": %llu\n", (unsigned long long) total->failed);
+        printf("  }\n");
+    }
+    printf("}\n");
+
+    for (int i = 0; i < scan.num_paths; i ++) {
+        free(scan.paths[i]);
+    }
+    free(scan.paths);
+    free(threads);
+    free(total);
+    return 0;
+}
@@ -47,7 +47,7 @@ uint8_t process_opcode(struct instruction *instruct, BYTE op_num) {
      */
 
     uint8_t args = 0;
-    enum opcode operation;
+    enum opcode operation = MOV;
     switch (op_num) {
         case 0:
             operation = MOV;
@@ -94,7 +94,7 @@ int process_valcode(struct instruction *instruct, BYTE val_code, int arg) {
      */
 
     int to_read = 0;
-    enum val_type type;
+    enum val_type type = VAL;
     switch (val_code) {
         case 0:
             type = VAL;
@@ -117,11 +117,23 @@ int process_valcode(struct instruction *instruct, BYTE val_code, int arg) {
     return to_read;
 }
 
-int parse(struct function *func_array, BYTE *bit_array, int num_bytes) {
+int has_bits(int bits_read, int to_read, int num_bytes) {
+    /*
+    * Returns 1 if 'to_read' more bits can be read from a bit_array of
+    * 'num_bytes' bytes after 'bits_read' bits, otherwise returns 0
+    */
+
+    return bits_read + to_read <= num_bytes * BYTE_SIZE;
+}
+
+int parse(struct function *func_array, int max_func, BYTE *bit_array,
+          int num_bytes) {
     /*
     * Given bit_array and the size of bit_array in bytes, processes bit_array
-    * into Functions and stores in func_array
-    * Returns number of functions parsed
+    * into Functions and stores at most 'max_func' of them in func_array
+    * Returns number of functions parsed, PARSE_TRUNCATED if bit_array ends
+    * part way through a function or PARSE_TOO_MANY_FUNC if it holds more
+    * than 'max_func' functions
     */
     
     int num_func = 0;
@@ -131,17 +143,24 @@ int parse(struct function *func_array, BYTE *bit_array, int num_bytes) {
         int to_read = 5;
         struct function new_func;
 
+        if (num_func == max_func) {
+            return PARSE_TOO_MANY_FUNC;
+        }
+
         // Reads 5 bits to determine number of instructions in function
         BYTE num_instruct = read_bits(&bit_array, &bits_read, to_read);
         new_func.num_instruct = num_instruct;
         int instruct_count = num_instruct;
 
         while (instruct_count > 0) {
-            struct instruction new_instruct;
+            struct instruction new_instruct = {0};
 
             // Reads 3 bits to determine instruction opcode one at a time until
             // all opcodes have been processed
             to_read = 3;
+            if (!has_bits(bits_read, to_read, num_bytes)) {
+                return PARSE_TRUNCATED;
+            }
             BYTE op_num = read_bits(&bit_array, &bits_read, to_read);
             int args = process_opcode(&new_instruct, op_num);
 
@@ -150,8 +169,14 @@ int parse(struct function *func_array, BYTE *bit_array, int num_bytes) {
 
                 // Reads 2 bits to determine value type of instruction argument
                 to_read = 2;
+                if (!has_bits(bits_read, to_read, num_bytes)) {
+                    return PARSE_TRUNCATED;
+                }
                 BYTE val_code = read_bits(&bit_array, &bits_read, to_read);
                 to_read = process_valcode(&new_instruct, val_code, args);
+                if (!has_bits(bits_read, to_read, num_bytes)) {
+                    return PARSE_TRUNCATED;
+                }
 
                 // Reads number of bits associated with value type to get value
                 BYTE val = read_bits(&bit_array, &bits_read, to_read);
@@ -163,6 +188,9 @@ int parse(struct function *func_array, BYTE *bit_array, int num_bytes) {
 
         // Reads 3 bits to determine function label
         to_read = 3;
+        if (!has_bits(bits_read, to_read, num_bytes)) {
+            return PARSE_TRUNCATED;
+        }
         BYTE func_label = read_bits(&bit_array, &bits_read, to_read);
         new_func.label = func_label;
         *func_array = new_func;
@@ -172,3 +200,17 @@ int parse(struct function *func_array, BYTE *bit_array, int num_bytes) {
     }
     return num_func;
 }
+
+const char *parse_error(int error) {
+    /*
+    * Returns message describing error code returned by parse()
+    */
+
+    switch (error) {
+        case PARSE_TRUNCATED:
+            return "File ends part way through a function";
+        case PARSE_TOO_MANY_FUNC:
+            return "File contains more than 8 functions";
+    }
+    return "Unknown error";
+}
@@ -5,6 +5,11 @@
 #include "objects.h"
 
 #define BUF 637 // Maximum number of bytes in a valid x2017 file
+#define MAX_FUNC 8 // Functions are labelled with 3 bits
+
+// Errors returned by parse()
+#define PARSE_TRUNCATED -1
+#define PARSE_TOO_MANY_FUNC -2
 
 void update_ptr(BYTE **byte_array);
 
@@ -14,6 +19,11 @@ uint8_t process_opcode(struct instruction *instruct, BYTE op_num);
 
 int process_valcode(struct instruction *instruct, BYTE val_code, int arg);
 
-int parse(struct function *func_array, BYTE *bit_array, int num_bytes);
+int has_bits(int bits_read, int to_read, int num_bytes);
+
+int parse(struct function *func_array, int max_func, BYTE *bit_array,
+          int num_bytes);
+
+const char *parse_error(int error);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "perf.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+static const char *counter_names[PERF_NUM_COUNTERS] = {
+    "cycles",
+    "instructions",
+    "branch-misses",
+    "L1D read misses"
+};
+
+static uint64_t now_ns(void) {
+    /*
+     * Returns monotonic time in nanoseconds
+     */
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#ifdef __linux__
+static int open_counter(uint32_t type, uint64_t config) {
+    /*
+     * Opens a disabled user-space-only counter for the calling thread
+     * Returns file descriptor, or -1 if the counter is unavailable
+     */
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+void perf_open(struct perf_counters *counters) {
+    /*
+     * Opens every supported counter, recording why the last one failed
+     */
+
+    counters->open_errno = 0;
+    for (int i = 0; i < PERF_NUM_COUNTERS; i ++) {
+        counters->fd[i] = -1;
+    }
+
+#ifdef __linux__
+    uint32_t types[PERF_NUM_COUNTERS] = {
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE
+    };
+    uint64_t configs[PERF_NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+    };
+    for (int i = 0; i < PERF_NUM_COUNTERS; i ++) {
+        counters->fd[i] = open_counter(types[i], configs[i]);
+        if (counters->fd[i] == -1) {
+            counters->open_errno = errno;
+        }
+    }
+#else
+    counters->open_errno = ENOSYS;
+#endif
+}
+
+void perf_start(struct perf_counters *counters) {
+    /*
+     * Resets and enables all open counters
+     */
+
+#ifdef __linux__
+    for (int i = 0; i < PERF_NUM_COUNTERS; i ++) {
+        if (counters->fd[i] != -1) {
+            ioctl(counters->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+    counters->start_ns = now_ns();
+}
+
+void perf_stop(struct perf_counters *counters, struct perf_sample *sample) {
+    /*
+     * Disables all open counters and stores their values in 'sample', scaled
+     * up if the kernel had to multiplex them
+     */
+
+    sample->wall_ns = now_ns() - counters->start_ns;
+    for (int i = 0; i < PERF_NUM_COUNTERS; i ++) {
+        sample->valid[i] = 0;
+        sample->value[i] = 0;
+#ifdef __linux__
+        if (counters->fd[i] == -1) {
+            continue;
+        }
+        ioctl(counters->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+        // Layout given by PERF_FORMAT_TOTAL_TIME_ENABLED | _RUNNING
+        uint64_t data[3];
+        if (read(counters->fd[i], data, sizeof(data)) != sizeof(data) ||
+            data[2] == 0) {
+            continue;
+        }
+        double scale = (double) data[1] / data[2];
+        sample->value[i] = (uint64_t) (data[0] * scale);
+        sample->valid[i] = 1;
+#endif
+    }
+}
+
+void perf_close(struct perf_counters *counters) {
+    /*
+     * Closes all open counters
+     */
+
+    for (int i = 0; i < PERF_NUM_COUNTERS; i ++) {
+        if (counters->fd[i] != -1) {
+            close(counters->fd[i]);
+            counters->fd[i] = -1;
+        }
+    }
+}
+
+static void print_value(FILE *out, struct perf_sample *sample, int counter) {
+    if (sample->valid[counter]) {
+        fprintf(out, " %16llu", (unsigned long long) sample->value[counter]);
+    } else {
+        fprintf(out, " %16s", "n/a");
+    }
+}
+
+static void print_ratio(FILE *out, const char *name, struct perf_sample *exec,
+                        int counter, uint64_t divisor) {
+    fprintf(out, "  %-32s %16s", name, "");
+    if (exec->valid[counter] && divisor > 0) {
+        fprintf(out, " %16.3f\n", (double) exec->value[counter] / divisor);
+    } else {
+        fprintf(out, " %16s\n", "n/a");
+    }
+}
+
+void perf_report(FILE *out, struct perf_counters *counters,
+                 struct perf_sample *parse, struct perf_sample *exec,
+                 uint64_t guest_instructions, uint64_t dispatches) {
+    /*
+     * Prints counters for the parse and execution phases, followed by metrics
+     * derived from the execution phase. 'dispatches' counts instructions the
+     * interpreter actually decoded, which excludes those replayed by memo hits
+     */
+
+    fprintf(out, "STATS %28s %16s %16s\n", "", "parse", "execute");
+    for (int i = 0; i < PERF_NUM_COUNTERS; i ++) {
+        fprintf(out, "  %-32s", counter_names[i]);
+        print_value(out, parse, i);
+        print_value(out, exec, i);
+        fprintf(out, "\n");
+    }
+    fprintf(out, "  %-32s %16llu %16llu\n", "wall time (ns)",
+            (unsigned long long) parse->wall_ns,
+            (unsigned long long) exec->wall_ns);
+    fprintf(out, "  %-32s %16s %16llu\n", "guest instructions", "",
+            (unsigned long long) guest_instructions);
+
+    print_ratio(out, "host instr / guest instr", exec, PERF_INSTRUCTIONS,
+                guest_instructions);
+    print_ratio(out, "cycles / guest instr", exec, PERF_CYCLES,
+                guest_instructions);
+    print_ratio(out, "branch misses / dispatch", exec, PERF_BRANCH_MISSES,
+                dispatches);
+    print_ratio(out, "L1D misses / guest instr", exec, PERF_L1D_MISSES,
+                guest_instructions);
+
+    int num_open = 0;
+    for (int i = 0; i < PERF_NUM_COUNTERS; i ++) {
+        num_open += (counters->fd[i] != -1);
+    }
+    if (num_open == 0) {
+        fprintf(out, "  (hardware counters unavailable: %s)\n",
+                strerror(counters->open_errno));
+    } else if (num_open < PERF_NUM_COUNTERS) {
+        fprintf(out, "  (some hardware counters unavailable: %s)\n",
+                strerror(counters->open_errno));
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum perf_counter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_NUM_COUNTERS
+};
+
+// Counter values for one measured phase, in nanoseconds for 'wall_ns'
+struct perf_sample {
+    uint64_t value[PERF_NUM_COUNTERS];
+    uint8_t valid[PERF_NUM_COUNTERS];
+    uint64_t wall_ns;
+};
+
+/*
+ * Per-thread hardware counters. Each counter is opened on its own so that the
+ * ones the host (or container) does not expose are skipped while the rest
+ * keep working; 'fd' is -1 for a counter that could not be opened
+ */
+struct perf_counters {
+    int fd[PERF_NUM_COUNTERS];
+    int open_errno;
+    uint64_t start_ns;
+};
+
+void perf_open(struct perf_counters *counters);
+
+void perf_start(struct perf_counters *counters);
+
+void perf_stop(struct perf_counters *counters, struct perf_sample *sample);
+
+void perf_close(struct perf_counters *counters);
+
+void perf_report(FILE *out, struct perf_counters *counters,
+                 struct perf_sample *parse, struct perf_sample *exec,
+                 uint64_t guest_instructions, uint64_t dispatches);
+
+#endif
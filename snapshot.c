@@ -0,0 +1,152 @@
+#include <string.h>
+#include "snapshot.h"
+#include "parser.h"
+
+void vm_snapshot(struct vm *snapshot, struct vm *vm) {
+    /*
+    * Captures the complete state of 'vm' in 'snapshot'
+    */
+
+    memcpy(snapshot, vm, sizeof(*vm));
+}
+
+void vm_reset(struct vm *vm, struct vm *snapshot) {
+    /*
+    * Returns 'vm' to the state captured in 'snapshot', e.g. straight after
+    * loading, without re-reading or re-parsing the program
+    */
+
+    memcpy(vm, snapshot, sizeof(*vm));
+}
+
+int snapshot_save(struct vm *vm, const char *path) {
+    /*
+    * Writes state of 'vm' to 'path': a header, instruction count and the
+    * threshold the code was inlined with, the registers and ram, then each
+    * function as its label, instruction count and 4 bytes per instruction
+    * Returns 0 on success, -1 on failure
+    */
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    BYTE header[14];
+    memcpy(header, SNAPSHOT_MAGIC, 4);
+    header[4] = SNAPSHOT_VERSION;
+    for (int i = 0; i < 8; i ++) {
+        header[5 + i] = (vm->executed >> (i * BYTE_SIZE)) & 0xFF;
+    }
+    header[13] = vm->inline_threshold;
+    fwrite(header, 1, sizeof(header), file);
+    fwrite(vm->reg, 1, REG_LIMIT, file);
+    fwrite(vm->ram, 1, RAM_LIMIT, file);
+    fputc(vm->num_instruct, file);
+
+    for (int i = 0; i < vm->num_instruct; i ++) {
+        struct function *func = &vm->code_mem[i];
+        fputc(func->label, file);
+        fputc(func->num_instruct, file);
+        for (int j = 0; j < func->num_instruct; j ++) {
+            struct instruction *instruct = &func->instructions[j];
+            BYTE packed[4] = {
+                (instruct->operation << 4) | instruct->num_args,
+                instruct->type[0] | (instruct->type[1] << 2),
+                instruct->val[0],
+                instruct->val[1]
+            };
+            fwrite(packed, 1, sizeof(packed), file);
+        }
+    }
+
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        return -1;
+    }
+    return 0;
+}
+
+int snapshot_load(struct vm *vm, const char *path) {
+    /*
+    * Restores state of 'vm' from a snapshot written by snapshot_save()
+    * Returns 0 on success, -1 if the file cannot be read or is not valid
+    */
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    memset(vm, 0, sizeof(*vm));
+    BYTE header[14];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, SNAPSHOT_MAGIC, 4) != 0 ||
+        header[4] != SNAPSHOT_VERSION ||
+        fread(vm->reg, 1, REG_LIMIT, file) != REG_LIMIT ||
+        fread(vm->ram, 1, RAM_LIMIT, file) != RAM_LIMIT) {
+        fclose(file);
+        return -1;
+    }
+    for (int i = 0; i < 8; i ++) {
+        vm->executed |= (uint64_t) header[5 + i] << (i * BYTE_SIZE);
+    }
+    vm->inline_threshold = (int8_t) header[13];
+
+    int num_func = fgetc(file);
+    if (num_func == EOF || num_func > REG_LIMIT) {
+        fclose(file);
+        return -1;
+    }
+    vm->num_instruct = num_func;
+
+    for (int i = 0; i < num_func; i ++) {
+        struct function *func = &vm->code_mem[i];
+        int label = fgetc(file);
+        int num_instruct = fgetc(file);
+        if (label == EOF || num_instruct == EOF || num_instruct > 32) {
+            fclose(file);
+            return -1;
+        }
+        func->label = label;
+        func->num_instruct = num_instruct;
+
+        for (int j = 0; j < num_instruct; j ++) {
+            struct instruction *instruct = &func->instructions[j];
+            BYTE packed[4];
+            if (fread(packed, 1, sizeof(packed), file) != sizeof(packed) ||
+                (packed[0] >> 4) > EQU) {
+                fclose(file);
+                return -1;
+            }
+
+            // Operations read as many arguments as the parser would give
+            // them, whatever the record claims
+            int args = process_opcode(instruct, packed[0] >> 4);
+            if ((packed[0] & 0xF) != args) {
+                fclose(file);
+                return -1;
+            }
+            instruct->type[0] = packed[1] & 0x3;
+            instruct->type[1] = (packed[1] >> 2) & 0x3;
+            instruct->val[0] = packed[2];
+            instruct->val[1] = packed[3];
+
+            // Register arguments index the register bank directly
+            for (int k = 0; k < args; k ++) {
+                if (instruct->type[k] == REG && instruct->val[k] >= REG_LIMIT) {
+                    fclose(file);
+                    return -1;
+                }
+            }
+        }
+    }
+    fclose(file);
+
+    // The running function must exist for execution to resume
+    if (vm->reg[FUNC_PTR] >= num_func) {
+        return -1;
+    }
+    vm->out = stdout;
+    return 0;
+}
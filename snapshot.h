@@ -0,0 +1,17 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "vm.h"
+
+#define SNAPSHOT_MAGIC "X2SN"
+#define SNAPSHOT_VERSION 2
+
+void vm_snapshot(struct vm *snapshot, struct vm *vm);
+
+void vm_reset(struct vm *vm, struct vm *snapshot);
+
+int snapshot_save(struct vm *vm, const char *path);
+
+int snapshot_load(struct vm *vm, const char *path);
+
+#endif
@@ -17,6 +17,128 @@ for file in `ls tests/*.asm`; do
     echo
 done
 
+for file in `ls tests/*.asm`; do
+    total=$((total+1))
+    name=$(basename -s .asm "$file")
+    echo "TEST $name" >> tests/results.txt
+    echo "    vm_x2017 --memo --no-inline:" >> tests/results.txt
+    ./vm_x2017 --memo --no-inline tests/$name.x2017 2> tests/$name.tmp | diff - tests/$name.out >> tests/results.txt && passed=$((passed+1)) && echo "Test '$name' (memo) passed." && echo "        PASSED" >> tests/results.txt || echo "Test '$name' (memo) failed; see results.txt"
+
+    # Programs with a .memo file also check how many calls were reused
+    if [ -f tests/$name.memo ]; then
+        total=$((total+1))
+        echo "    vm_x2017 --memo (report):" >> tests/results.txt
+        diff tests/$name.tmp tests/$name.memo >> tests/results.txt && passed=$((passed+1)) && echo "Test '$name' (memo report) passed." && echo "        PASSED" >> tests/results.txt || echo "Test '$name' (memo report) failed; see results.txt"
+    fi
+    rm -f tests/$name.tmp
+    echo "------------------------------------------------------------------------------" >> tests/results.txt
+    echo
+done
+
+for file in `ls tests/*.asm`; do
+    total=$((total+1))
+    name=$(basename -s .asm "$file")
+    echo "TEST $name" >> tests/results.txt
+    echo "    vm_x2017 --no-inline:" >> tests/results.txt
+    ./vm_x2017 --no-inline tests/$name.x2017 | diff - tests/$name.out >> tests/results.txt && passed=$((passed+1)) && echo "Test '$name' (no inline) passed." && echo "        PASSED" >> tests/results.txt || echo "Test '$name' (no inline) failed; see results.txt"
+    echo "------------------------------------------------------------------------------" >> tests/results.txt
+    echo
+done
+
+for file in `ls tests/*.inline`; do
+    total=$((total+1))
+    name=$(basename -s .inline "$file")
+    echo "TEST $name" >> tests/results.txt
+    echo "    objdump_x2017 --inline:" >> tests/results.txt
+    ./objdump_x2017 --inline tests/$name.x2017 | diff - tests/$name.inline >> tests/results.txt && passed=$((passed+1)) && echo "Test '$name' (inline) passed." && echo "        PASSED" >> tests/results.txt || echo "Test '$name' (inline) failed; see results.txt"
+    echo "------------------------------------------------------------------------------" >> tests/results.txt
+    echo
+done
+
+for file in `ls tests/*.trace`; do
+    total=$((total+1))
+    name=$(basename -s .trace "$file")
+    echo "TEST $name" >> tests/results.txt
+    echo "    tracedump_x2017:" >> tests/results.txt
+    ./vm_x2017 --no-inline --trace tests/$name.tmp tests/$name.x2017 > /dev/null
+    ./tracedump_x2017 tests/$name.tmp tests/$name.x2017 | diff - tests/$name.trace >> tests/results.txt && passed=$((passed+1)) && echo "Test '$name' (trace) passed." && echo "        PASSED" >> tests/results.txt || echo "Test '$name' (trace) failed; see results.txt"
+    rm -f tests/$name.tmp
+    echo "------------------------------------------------------------------------------" >> tests/results.txt
+    echo
+done
+
+# Traces of inlined programs, recorded directly and after a restore, decode
+# against the same inlined code
+for file in `ls tests/*.itrace`; do
+    total=$((total+2))
+    name=$(basename -s .itrace "$file")
+    echo "TEST $name" >> tests/results.txt
+    echo "    tracedump_x2017 (inline):" >> tests/results.txt
+    ./vm_x2017 --trace tests/$name.tmp tests/$name.x2017 > /dev/null
+    ./tracedump_x2017 tests/$name.tmp tests/$name.x2017 | diff - tests/$name.itrace >> tests/results.txt && passed=$((passed+1)) && echo "Test '$name' (inline trace) passed." && echo "        PASSED" >> tests/results.txt || echo "Test '$name' (inline trace) failed; see results.txt"
+    echo "    tracedump_x2017 (inline, restored):" >> tests/results.txt
+    ./vm_x2017 --snapshot tests/$name.snap --snapshot-at 0 tests/$name.x2017 > /dev/null
+    ./vm_x2017 --trace tests/$name.tmp --restore tests/$name.snap > /dev/null
+    ./tracedump_x2017 tests/$name.tmp tests/$name.x2017 | diff - tests/$name.itrace >> tests/results.txt && passed=$((passed+1)) && echo "Test '$name' (restored inline trace) passed." && echo "        PASSED" >> tests/results.txt || echo "Test '$name' (restored inline trace) failed; see results.txt"
+    rm -f tests/$name.tmp tests/$name.snap
+    echo "------------------------------------------------------------------------------" >> tests/results.txt
+    echo
+done
+
+for file in `ls tests/*.asm`; do
+    name=$(basename -s .asm "$file")
+
+    # Only programs that run to completion leave a snapshot worth restoring
+    ./vm_x2017 --snapshot tests/$name.snap tests/$name.x2017 > /dev/null 2>&1 || { rm -f tests/$name.snap; continue; }
+    total=$((total+1))
+    echo "TEST $name" >> tests/results.txt
+    echo "    vm_x2017 --restore:" >> tests/results.txt
+    ./vm_x2017 --restore tests/$name.snap | diff - tests/$name.out >> tests/results.txt && passed=$((passed+1)) && echo "Test '$name' (restore) passed." && echo "        PASSED" >> tests/results.txt || echo "Test '$name' (restore) failed; see results.txt"
+    rm -f tests/$name.snap
+    echo "------------------------------------------------------------------------------" >> tests/results.txt
+    echo
+done
+
+# A snapshot taken part way through resumes with the rest of the full run's
+# output, and repeated runs each print the whole output again
+name=snapshot_mid
+total=$((total+2))
+echo "TEST $name" >> tests/results.txt
+echo "    vm_x2017 --snapshot-at 14, --restore:" >> tests/results.txt
+./vm_x2017 --no-inline --snapshot tests/$name.snap --snapshot-at 14 tests/$name.x2017 > tests/$name.tmp
+./vm_x2017 --restore tests/$name.snap > tests/$name.resumed
+lines=$(wc -l < tests/$name.resumed)
+[ "$lines" -gt 0 ] && [ "$lines" -lt $(wc -l < tests/$name.out) ] && diff tests/$name.tmp tests/$name.out >> tests/results.txt && tail -n "$lines" tests/$name.out | diff - tests/$name.resumed >> tests/results.txt && passed=$((passed+1)) && echo "Test '$name' (mid-run restore) passed." && echo "        PASSED" >> tests/results.txt || echo "Test '$name' (mid-run restore) failed; see results.txt"
+echo "    vm_x2017 --runs 2:" >> tests/results.txt
+./vm_x2017 --runs 2 tests/$name.x2017 | diff - <(cat tests/$name.out tests/$name.out) >> tests/results.txt && passed=$((passed+1)) && echo "Test '$name' (runs) passed." && echo "        PASSED" >> tests/results.txt || echo "Test '$name' (runs) failed; see results.txt"
+rm -f tests/$name.snap tests/$name.tmp tests/$name.resumed
+echo "------------------------------------------------------------------------------" >> tests/results.txt
+echo
+
+# Batch mode prints each file under its name in command line order, whatever
+# order the workers finish in, and fails if any file did
+batch="tests/simple_cal.x2017 tests/empty.x2017 tests/missing.x2017 tests/full_file.x2017 tests/simple_mov.x2017"
+for threads in 1 4; do
+    total=$((total+1))
+    echo "TEST batch" >> tests/results.txt
+    echo "    objdump_x2017 -j $threads:" >> tests/results.txt
+    { ./objdump_x2017 -j $threads $batch 2>&1; echo "exit $?"; } | diff - tests/batch.objdump >> tests/results.txt && passed=$((passed+1)) && echo "Test 'batch' (objdump -j $threads) passed." && echo "        PASSED" >> tests/results.txt || echo "Test 'batch' (objdump -j $threads) failed; see results.txt"
+    echo "------------------------------------------------------------------------------" >> tests/results.txt
+    echo
+done
+
+for file in `ls tests/*.stats`; do
+    total=$((total+2))
+    name=$(basename -s .stats "$file")
+    echo "TEST $name" >> tests/results.txt
+    echo "    opstats_x2017:" >> tests/results.txt
+    ./opstats_x2017 tests/$name.x2017 | diff - tests/$name.stats >> tests/results.txt && passed=$((passed+1)) && echo "Test '$name' (opstats) passed." && echo "        PASSED" >> tests/results.txt || echo "Test '$name' (opstats) failed; see results.txt"
+    echo "    opstats_x2017 --dynamic:" >> tests/results.txt
+    ./opstats_x2017 --dynamic tests/$name.x2017 | diff - tests/$name.dstats >> tests/results.txt && passed=$((passed+1)) && echo "Test '$name' (opstats dynamic) passed." && echo "        PASSED" >> tests/results.txt || echo "Test '$name' (opstats dynamic) failed; see results.txt"
+    echo "------------------------------------------------------------------------------" >> tests/results.txt
+    echo
+done
+
 echo "------------------------------------------------------------------------------"
 echo
 echo "PASSED $passed/$total TESTS."
@@ -0,0 +1,12 @@
+FUNC LABEL 0
+    MOV STK A VAL 3
+    CAL VAL 1
+    MOV REG 1 REG 5
+    PRINT REG 1
+    PRINT REG 0
+    PRINT STK A
+    RET
+FUNC LABEL 1
+    MOV STK A VAL 9
+    MOV REG 0 STK A
+    RET
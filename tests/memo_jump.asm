@@ -0,0 +1,11 @@
+FUNC LABEL 0
+    CAL VAL 1
+    CAL VAL 1
+    RET
+FUNC LABEL 1
+    MOV REG 6 VAL 0
+    RET
+FUNC LABEL 2
+    PRINT VAL 7
+    PRINT VAL 9
+    RET
@@ -0,0 +1,21 @@
+FUNC LABEL 0
+    CAL VAL 1
+    CAL VAL 1
+    RET
+FUNC LABEL 1
+    CAL VAL 2
+    RET
+FUNC LABEL 2
+    REF REG 0 STK A
+    MOV REG 1 VAL 254
+    ADD REG 0 REG 1
+    MOV STK A REG 0
+    MOV PTR A VAL 0
+    MOV REG 1 VAL 1
+    ADD REG 0 REG 1
+    MOV STK A REG 0
+    MOV PTR A VAL 0
+    RET
+FUNC LABEL 3
+    PRINT VAL 7
+    RET
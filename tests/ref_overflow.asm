@@ -0,0 +1,25 @@
+FUNC LABEL 0
+    CAL VAL 1
+    RET
+FUNC LABEL 1
+    CAL VAL 2
+    RET
+FUNC LABEL 2
+    CAL VAL 3
+    RET
+FUNC LABEL 3
+    CAL VAL 4
+    RET
+FUNC LABEL 4
+    CAL VAL 5
+    RET
+FUNC LABEL 5
+    CAL VAL 6
+    RET
+FUNC LABEL 6
+    CAL VAL 7
+    RET
+FUNC LABEL 7
+    REF REG 0 STK A
+    PRINT REG 0
+    RET
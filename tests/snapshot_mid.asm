@@ -0,0 +1,21 @@
+FUNC LABEL 0
+    MOV STK A VAL 1
+    PRINT STK A
+    CAL VAL 1
+    PRINT STK A
+    RET
+FUNC LABEL 1
+    MOV STK A VAL 2
+    PRINT STK A
+    MOV REG 0 VAL 3
+    PRINT REG 0
+    NOT REG 0
+    NOT REG 0
+    MOV REG 1 VAL 4
+    PRINT REG 1
+    ADD REG 1 REG 0
+    PRINT REG 1
+    MOV STK B VAL 5
+    PRINT STK B
+    PRINT STK A
+    RET
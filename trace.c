@@ -0,0 +1,125 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace.h"
+
+static struct trace *active_trace = NULL;
+
+int trace_init(struct trace *trace, const char *path, uint64_t min_records) {
+    /*
+     * Opens 'path' for the trace dump and allocates a ring buffer holding at
+     * least 'min_records' records (rounded up to a power of two), at most
+     * TRACE_MAX_RECORDS
+     * Returns 0 on success, -1 on failure
+     */
+
+    if (min_records > TRACE_MAX_RECORDS) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint64_t capacity = 1;
+    while (capacity < min_records) {
+        capacity <<= 1;
+    }
+
+    trace->records = calloc(capacity, sizeof(struct trace_record));
+    if (trace->records == NULL) {
+        return -1;
+    }
+    trace->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (trace->fd == -1) {
+        free(trace->records);
+        trace->records = NULL;
+        return -1;
+    }
+    trace->mask = capacity - 1;
+    trace->head = 0;
+    trace->dumped = 0;
+    trace->inline_threshold = -1;
+    return 0;
+}
+
+static void write_all(int fd, const void *data, size_t size) {
+    /*
+     * Writes 'size' bytes of 'data' to 'fd', retrying on short writes
+     */
+
+    const char *ptr = data;
+    while (size > 0) {
+        ssize_t written = write(fd, ptr, size);
+        if (written <= 0) {
+            return;
+        }
+        ptr += written;
+        size -= written;
+    }
+}
+
+void trace_dump(struct trace *trace) {
+    /*
+     * Writes the header and buffered records, oldest first, to the trace file
+     * Only uses write(2) so that it is safe to call from a signal handler
+     */
+
+    if (trace->records == NULL || trace->dumped) {
+        return;
+    }
+    trace->dumped = 1;
+
+    uint64_t head = __atomic_load_n(&trace->head, __ATOMIC_ACQUIRE);
+    uint64_t capacity = trace->mask + 1;
+    uint64_t count = head < capacity ? head : capacity;
+
+    struct trace_header header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(struct trace_record);
+    header.num_records = count;
+    header.total = head;
+    header.inline_threshold = trace->inline_threshold;
+    header.pad = 0;
+    write_all(trace->fd, &header, sizeof(header));
+
+    // Once the buffer has wrapped, the oldest record is the one at 'head'
+    uint64_t start = (head - count) & trace->mask;
+    uint64_t first = capacity - start < count ? capacity - start : count;
+    write_all(trace->fd, &trace->records[start],
+              first * sizeof(struct trace_record));
+    write_all(trace->fd, trace->records,
+              (count - first) * sizeof(struct trace_record));
+    close(trace->fd);
+}
+
+static void dump_at_exit(void) {
+    trace_dump(active_trace);
+    free(active_trace->records);
+    active_trace->records = NULL;
+}
+
+static void dump_on_signal(int sig) {
+    trace_dump(active_trace);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+void trace_install(struct trace *trace) {
+    /*
+     * Arranges for 'trace' to be dumped when the program exits, including
+     * through exit() on a program error, or is killed by a signal
+     */
+
+    active_trace = trace;
+    atexit(dump_at_exit);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = dump_on_signal;
+    sigemptyset(&action.sa_mask);
+    int signals[] = {SIGINT, SIGTERM, SIGHUP, SIGSEGV, SIGBUS, SIGABRT};
+    for (int i = 0; i < sizeof(signals) / sizeof(signals[0]); i ++) {
+        sigaction(signals[i], &action, NULL);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "objects.h"
+
+#define TRACE_MAGIC "X2TR"
+#define TRACE_VERSION 2
+#define TRACE_DEFAULT_RECORDS (1 << 22) // Last ~4 million instructions
+#define TRACE_MAX_RECORDS (1ULL << 31)  // Largest count the header can hold
+
+/*
+ * One executed instruction. Kept at 8 bytes so that the ring buffer index is a
+ * shift and a mask and a record never straddles a cache line
+ */
+struct trace_record {
+    uint8_t func;       // Index of function in code memory
+    uint8_t pc;         // Program counter before execution
+    uint8_t opcode;
+    uint8_t dest_val;   // Value written (or printed) by the instruction
+    uint8_t sp;         // Stack pointer before execution
+    uint8_t fp;         // Frame pointer before execution
+    uint8_t pad[2];
+};
+
+// Header at the start of a dumped trace file, records follow oldest first
+struct trace_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t num_records;
+    uint64_t total;     // Number of instructions executed while tracing
+    int32_t inline_threshold;   // Inlining applied to the program, -1 if none
+    uint32_t pad;
+};
+
+/*
+ * Ring buffer of the most recent records. Only the thread executing the VM
+ * writes to it; 'head' is published with a release store once a record's
+ * location fields are filled in, before the instruction executes, so a dump
+ * taken on an error includes the faulting instruction
+ */
+struct trace {
+    struct trace_record *records;
+    uint64_t mask;
+    uint64_t head;
+    int fd;
+    int dumped;
+    int32_t inline_threshold;
+};
+
+int trace_init(struct trace *trace, const char *path, uint64_t min_records);
+
+void trace_dump(struct trace *trace);
+
+void trace_install(struct trace *trace);
+
+static inline struct trace_record *trace_slot(struct trace *trace) {
+    /*
+     * Returns the record to fill in for the next instruction
+     */
+
+    return &trace->records[trace->head & trace->mask];
+}
+
+static inline void trace_commit(struct trace *trace) {
+    /*
+     * Publishes the record returned by the last call to trace_slot()
+     */
+
+    __atomic_store_n(&trace->head, trace->head + 1, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,107 @@
+#include <string.h>
+#include "objdump.h"
+#include "trace.h"
+#include "inline.h"
+
+int main(int argc, char **argv) {
+    // Handles file errors and parses program the trace was recorded from
+    if (argc != 3) {
+        printf("Error: Please provide <trace file> <filename> as command line "
+               "arguments\n");
+        return 1;
+    }
+
+    FILE *bin_file = fopen(argv[2], "rb");
+    if (bin_file == NULL) {
+        perror("Error: File could not be opened");
+        return 1;
+    }
+
+    fseek(bin_file, 0, SEEK_END);
+    int num_bytes = ftell(bin_file);
+    if (num_bytes == 0) {
+        printf("Error: File cannot be empty\n");
+        return 1;
+    }
+    if (num_bytes > BUF) {
+        printf("Error: File is too large\n");
+        return 1;
+    }
+    fseek(bin_file, 0, SEEK_SET);
+
+    BYTE f_bits[BUF] = {0};
+    fread(f_bits, 1, num_bytes, bin_file);
+    fclose(bin_file);
+
+    struct function func_array[8] = {0};
+    BYTE *bit_ptr = &f_bits[num_bytes - 1];
+    int num_func = parse(func_array, MAX_FUNC, bit_ptr, num_bytes);
+    if (num_func < 0) {
+        printf("Error: %s\n", parse_error(num_func));
+        return 1;
+    }
+
+    FILE *trace_file = fopen(argv[1], "rb");
+    if (trace_file == NULL) {
+        perror("Error: Trace could not be opened");
+        return 1;
+    }
+
+    struct trace_header header;
+    if (fread(&header, sizeof(header), 1, trace_file) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TRACE_VERSION ||
+        header.record_size != sizeof(struct trace_record)) {
+        printf("Error: Not a valid x2017 trace\n");
+        fclose(trace_file);
+        return 1;
+    }
+
+    // Records index the program as it ran, so repeats any inlining
+    if (header.inline_threshold >= 0) {
+        inline_leaves(func_array, num_func, header.inline_threshold);
+    }
+
+    // Renders every instruction once up front so that decoding each record is
+    // a table lookup; symbols are lettered per function as objdump does
+    static char text[8][32][INSTRUCT_BUF];
+    for (int i = 0; i < num_func; i ++) {
+        char symbol_map[SYM_BUF] = {0};
+        int num_symbols = 0;
+        for (int j = 0; j < func_array[i].num_instruct; j ++) {
+            format_instruction(text[i][j], &func_array[i].instructions[j],
+                               symbol_map, &num_symbols);
+        }
+    }
+
+    printf("TRACE %llu instructions, last %u shown\n",
+           (unsigned long long) header.total, header.num_records);
+
+    // Prints records oldest first, numbered by position in the full execution
+    uint64_t seq = header.total - header.num_records;
+    struct trace_record record;
+    while (fread(&record, sizeof(record), 1, trace_file) == 1) {
+        if (record.func >= num_func ||
+            record.pc >= func_array[record.func].num_instruct) {
+            printf("%10llu    <invalid FUNC %d PC %d>\n",
+                   (unsigned long long) seq, record.func, record.pc);
+            seq ++;
+            continue;
+        }
+
+        char *line = text[record.func][record.pc];
+        int has_value = (record.opcode != CAL && record.opcode != RET);
+        printf("%10llu    FUNC LABEL %d PC %-2d    %-20s", 
+               (unsigned long long) seq, func_array[record.func].label,
+               record.pc, line);
+        if (has_value) {
+            printf(" = %-3d", record.dest_val);
+        } else {
+            printf("      ");
+        }
+        printf("    SP %d FP %d\n", record.sp, record.fp);
+        seq ++;
+    }
+    fclose(trace_file);
+    return 0;
+}
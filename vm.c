@@ -0,0 +1,554 @@
+#include <string.h>
+#include "vm.h"
+#include "trace.h"
+#include "memo.h"
+
+uint8_t is_main(struct vm *vm) {
+    /*
+    * Returns 1 is current function being executed is main(), otherwise
+    * returns 0
+    */
+
+    uint8_t main_add = get_func(vm, 0);
+    if (vm->reg[FUNC_PTR] == main_add) {
+        return 1;
+    }
+    return 0;
+}
+
+uint8_t is_ret(struct vm *vm) {
+    /*
+    * Returns 1 if the current instruction being executed is a RET, otherwise
+    * returns 0
+    */
+
+    struct function func = vm->code_mem[vm->reg[FUNC_PTR]];
+    struct instruction instruct = func.instructions[vm->reg[PROG_CTR]];
+    return (instruct.operation == RET);
+}
+
+int get_func(struct vm *vm, uint8_t label) {
+    /*
+    * Returns index location of function with label 'label' within code memory
+    */
+
+   int result = NO_VAL;
+    int num_func = 0;
+    for (int i = 0; i < vm->num_instruct; i ++) {
+        if (vm->code_mem[i].label == label) {
+            result = i;
+            num_func ++;
+        }
+    }
+    if (num_func != 1) {
+        return NO_VAL;
+    }
+    return result;
+}
+
+uint8_t is_running(struct vm *vm) {
+    /* 
+    * Returns 1 if program has reached a return operation in main(), i.e. has
+    * reached end of program
+    */
+
+   return !((is_main(vm)) && (is_ret(vm)));
+};
+
+void increment_pc(struct vm *vm) {
+    /*
+    * Increments program counter by one index
+    */
+
+    vm->reg[PROG_CTR] ++;
+}
+
+void increment_sp(struct vm *vm) {
+    /*
+    * Increments stack pointer by one index
+    */
+
+    vm->reg[STK_PTR] ++;
+}
+
+void decrement_sp(struct vm *vm) {
+    /*
+    * Decrements stack pointer by one index
+    */
+
+    vm->reg[STK_PTR] --;
+}
+
+void push_to_stack(struct vm *vm, BYTE *value) {
+    /*
+    * Pushes object at 'value' onto stack
+    */
+
+    vm->ram[vm->reg[STK_PTR]] = *value;
+    increment_sp(vm);
+}
+
+void pop_from_stack(struct vm *vm) {
+    /*
+    * 'Pops' all variables from current stackframe
+    */
+
+    vm->reg[STK_PTR] = vm->reg[FRAME_PTR];
+} 
+
+int def_new_frame(struct vm *vm) {
+    /*
+    * Defines starting point of a new stack frame
+    * Returns VM_ERR_STACK_OVERFLOW if the frame does not fit in RAM
+    */
+
+    if (vm->reg[FRAME_PTR] + SYM_BUF + RET_OFFSET >= RAM_LIMIT) {
+        return VM_ERR_STACK_OVERFLOW;
+    }
+    vm->reg[FRAME_PTR] += SYM_BUF + RET_OFFSET;
+    vm->reg[STK_PTR] = vm->reg[FRAME_PTR] - RET_OFFSET;
+    return VM_OK;
+}
+
+void set_pc(struct vm *vm, uint8_t num) {
+    /*
+    * Sets program counter to address 'num'
+    */
+
+    vm->reg[PROG_CTR] = num;
+}
+
+int stack_address(struct vm *vm, uint8_t frame, uint8_t symbol) {
+    /*
+    * Returns RAM address of stack symbol 'symbol' in the frame starting at
+    * 'frame', or NO_VAL if it lies beyond the end of RAM
+    */
+
+    int address = frame + symbol;
+    if (address >= RAM_LIMIT) {
+        vm->error_val = symbol;
+        return NO_VAL;
+    }
+    return address;
+}
+
+int op_mov(struct vm *vm, struct instruction *instruct) {
+    /*
+    * Executes MOV operation
+    */
+
+    increment_pc(vm);
+    uint8_t val = instruct->val[0];
+    int address;
+    switch (instruct->type[0]) {
+        case VAL:
+            break;
+        case REG:
+            val = vm->reg[val];
+            break;
+        case STK:
+            address = stack_address(vm, vm->reg[FRAME_PTR], val);
+            if (address == NO_VAL) {
+                return VM_ERR_ADDRESS;
+            }
+            val = vm->ram[address];
+            break;
+        case PTR:
+            address = stack_address(vm, vm->reg[FRAME_PTR], val);
+            if (address == NO_VAL) {
+                return VM_ERR_ADDRESS;
+            }
+            val = vm->ram[vm->ram[address]];
+            break;
+    }
+    
+    uint8_t destination = instruct->val[1];
+    switch (instruct->type[1]) {
+        case REG:
+            vm->reg[destination] = val;
+            break;
+        case STK:
+            address = stack_address(vm, vm->reg[FRAME_PTR], destination);
+            if (address == NO_VAL) {
+                return VM_ERR_ADDRESS;
+            }
+            vm->ram[address] = val;
+            break;
+        case PTR:
+            address = stack_address(vm, vm->reg[FRAME_PTR], destination);
+            if (address == NO_VAL) {
+                return VM_ERR_ADDRESS;
+            }
+            vm->ram[vm->ram[address]] = val;
+            break;
+        default:
+            return VM_ERR_ARG_TYPE;
+    }
+    return VM_OK;
+}
+
+int op_cal(struct vm *vm, struct instruction *instruct) {
+    /*
+    * Executes CAL operation
+    */   
+
+    if (instruct->type[0] != VAL) {
+        return VM_ERR_ARG_TYPE;
+    }
+    uint8_t func_address = instruct->val[0];
+    int func_index = get_func(vm, func_address);
+    if (func_index == NO_VAL) {
+        vm->error_val = func_address;
+        return VM_ERR_NO_FUNC;
+    }
+    increment_pc(vm);
+    int status = def_new_frame(vm);
+    if (status != VM_OK) {
+        return status;
+    }
+
+    // Pushes return addresses onto stack
+    push_to_stack(vm, &vm->reg[FUNC_PTR]);
+    push_to_stack(vm, &vm->reg[PROG_CTR]);
+
+    vm->reg[FUNC_PTR] = func_index;
+    set_pc(vm, DEFAULT_VAL);
+    return VM_OK;
+}
+
+int op_ret(struct vm *vm) {
+    /*
+    * Executes RET operation
+    */
+
+    increment_pc(vm);
+    pop_from_stack(vm);
+    vm->reg[FRAME_PTR] = vm->reg[FRAME_PTR] - SYM_BUF - RET_OFFSET;
+
+    // Retrieves function return addresses
+    decrement_sp(vm);
+    vm->reg[PROG_CTR] = vm->ram[vm->reg[STK_PTR]];
+    decrement_sp(vm);
+    vm->reg[FUNC_PTR] = vm->ram[vm->reg[STK_PTR]];
+    return VM_OK;
+}
+
+int op_ref(struct vm *vm, struct instruction *instruct) {
+    /*
+    * Executes REF operation
+    */
+
+    increment_pc(vm);
+
+    uint8_t symbol = instruct->val[0];
+    int address;
+    switch (instruct->type[0]) {
+        case STK:
+            address = stack_address(vm, vm->reg[FRAME_PTR], symbol);
+            if (address == NO_VAL) {
+                return VM_ERR_ADDRESS;
+            }
+            symbol = address;
+            break;
+        case PTR:
+            address = stack_address(vm, vm->reg[FRAME_PTR], symbol);
+            if (address == NO_VAL) {
+                return VM_ERR_ADDRESS;
+            }
+            symbol = vm->ram[address];
+            break;
+        default:
+            return VM_ERR_ARG_TYPE;
+    }
+
+    uint8_t destination = instruct->val[1];
+    switch (instruct->type[1]) {
+        case REG:
+            vm->reg[destination] = symbol;
+            break;
+        case STK:
+            address = stack_address(vm, vm->reg[FRAME_PTR], destination);
+            if (address == NO_VAL) {
+                return VM_ERR_ADDRESS;
+            }
+            vm->ram[address] = symbol;
+            break;
+        case PTR:
+            address = stack_address(vm, vm->reg[FRAME_PTR], destination);
+            if (address == NO_VAL) {
+                return VM_ERR_ADDRESS;
+            }
+            vm->ram[vm->ram[address]] = symbol;
+            break;
+        default:
+            return VM_ERR_ARG_TYPE;
+    }
+    return VM_OK;
+}
+
+int op_add(struct vm *vm, struct instruction *instruct) {
+    /*
+    * Executes ADD operation
+    */
+
+    if (instruct->type[0] != REG || instruct->type[1] != REG) {
+        return VM_ERR_ARG_TYPE;
+    }
+    increment_pc(vm);
+
+    uint8_t reg_one = instruct->val[1];
+    uint8_t reg_two = instruct->val[0];
+    vm->reg[reg_one] = vm->reg[reg_one] + vm->reg[reg_two];
+    return VM_OK;
+}
+
+int op_print(struct vm *vm, struct instruction *instruct) {
+    /*
+    * Executes PRINT operation
+    */
+
+    increment_pc(vm);
+
+    uint8_t arg_type = instruct->type[0];
+    uint8_t arg_val = instruct->val[0];
+    uint8_t value = arg_val;
+    int address;
+    switch (arg_type) {
+        case VAL:
+            break;
+        case REG:
+            value = vm->reg[arg_val];
+            break;
+        case STK:
+            address = stack_address(vm, vm->reg[FRAME_PTR], arg_val);
+            if (address == NO_VAL) {
+                return VM_ERR_ADDRESS;
+            }
+            value = vm->ram[address];
+            break;
+        case PTR:
+            address = stack_address(vm, vm->reg[FRAME_PTR], arg_val);
+            if (address == NO_VAL) {
+                return VM_ERR_ADDRESS;
+            }
+            value = vm->ram[vm->ram[address]];
+            break;
+    }
+    if (vm->out != NULL) {
+        fprintf(vm->out, "%d\n", value);
+    }
+    return VM_OK;
+}
+
+int op_not(struct vm *vm, struct instruction *instruct) {
+    /*
+    * Executes NOT operation
+    */
+
+    if (instruct->type[0] != REG) {
+        return VM_ERR_ARG_TYPE;
+    }
+    increment_pc(vm);
+
+    uint8_t reg_add = instruct->val[0];
+    vm->reg[reg_add] = ~(vm->reg[reg_add]);
+    return VM_OK;
+}
+
+int op_equ(struct vm *vm, struct instruction *instruct) {
+    /*
+    * Executes EQU operation
+    */
+   
+    if (instruct->type[0] != REG) {
+        return VM_ERR_ARG_TYPE;
+    }
+    increment_pc(vm);
+
+    uint8_t reg_add = instruct->val[0];
+    if (vm->reg[reg_add] == 0) {
+        vm->reg[reg_add] = 1;
+    } else {
+        vm->reg[reg_add] = 0;
+    }
+    return VM_OK;
+}
+
+uint8_t read_operand(struct vm *vm, struct instruction *instruct, int arg,
+                     uint8_t frame) {
+    /*
+    * Returns current value of argument 'arg' of 'instruct', resolving stack
+    * symbols relative to frame pointer 'frame'
+    */
+
+    uint8_t val = instruct->val[arg];
+    int address = frame + val;
+    switch (instruct->type[arg]) {
+        case VAL:
+            break;
+        case REG:
+            val = vm->reg[val];
+            break;
+        case STK:
+            val = address < RAM_LIMIT ? vm->ram[address] : 0;
+            break;
+        case PTR:
+            val = address < RAM_LIMIT ? vm->ram[vm->ram[address]] : 0;
+            break;
+    }
+    return val;
+}
+
+uint8_t trace_value(struct vm *vm, struct instruction *instruct,
+                    uint8_t frame) {
+    /*
+    * Returns value written (or printed) by 'instruct' once it has executed in
+    * the frame starting at 'frame', or 0 for CAL and RET
+    */
+
+    switch (instruct->operation) {
+        case MOV:
+        case REF:
+        case ADD:
+            return read_operand(vm, instruct, 1, frame);
+        case PRINT:
+        case NOT:
+        case EQU:
+            return read_operand(vm, instruct, 0, frame);
+        default:
+            return 0;
+    }
+}
+
+void vm_init(struct vm *vm, int main_address) {
+    /*
+    * Clears memory and points registers at the start of main(); code memory
+    * must already be loaded
+    */
+
+    memset(vm->ram, 0, sizeof(vm->ram));
+    memset(vm->reg, 0, sizeof(vm->reg));
+    vm->reg[FRAME_PTR] = DEFAULT_VAL;
+    vm->reg[STK_PTR] = DEFAULT_VAL;
+    vm->reg[FUNC_PTR] = main_address;
+    vm->reg[PROG_CTR] = DEFAULT_VAL;
+    vm->executed = 0;
+    vm->out = stdout;
+    vm->memo = NULL;
+    vm->inline_threshold = -1;
+}
+
+int vm_step(struct vm *vm, struct instruction *instruct) {
+    /*
+    * Executes a single instruction
+    * Returns VM_OK, or the error that stopped the instruction
+    */
+
+    switch (instruct->operation) {
+        case MOV:
+            return op_mov(vm, instruct);
+        case CAL:
+            return op_cal(vm, instruct);
+        case RET:
+            return op_ret(vm);
+        case REF:
+            return op_ref(vm, instruct);
+        case ADD:
+            return op_add(vm, instruct);
+        case PRINT:
+            return op_print(vm, instruct);
+        case NOT:
+            return op_not(vm, instruct);
+        case EQU:
+            return op_equ(vm, instruct);
+    }
+    return VM_ERR_ARG_TYPE;
+}
+
+int vm_run(struct vm *vm, uint64_t limit, struct trace *trace) {
+    /*
+    * Executes program until end of main is reached or 'limit' instructions
+    * have been executed in total, recording each one in 'trace' if not NULL
+    * Returns VM_OK at end of program, VM_LIMIT if stopped by 'limit', or the
+    * error that stopped execution
+    */
+
+    while (1) {
+        // Function and program counter can only be out of range after a RET
+        // to a corrupted return address or a function without a final RET
+        if (vm->reg[FUNC_PTR] >= vm->num_instruct ||
+            vm->reg[PROG_CTR] >=
+                vm->code_mem[vm->reg[FUNC_PTR]].num_instruct) {
+            return VM_ERR_PC;
+        }
+        if (!is_running(vm)) {
+            return VM_OK;
+        }
+        if (vm->executed >= limit) {
+            return VM_LIMIT;
+        }
+        vm->executed ++;
+        struct function *current_func = &vm->code_mem[vm->reg[FUNC_PTR]];
+        struct instruction *current_instruct = &current_func->instructions \
+                                               [vm->reg[PROG_CTR]];
+        struct trace_record *record = NULL;
+        if (trace != NULL) {
+            record = trace_slot(trace);
+            record->func = vm->reg[FUNC_PTR];
+            record->pc = vm->reg[PROG_CTR];
+            record->opcode = current_instruct->operation;
+            record->sp = vm->reg[STK_PTR];
+            record->fp = vm->reg[FRAME_PTR];
+
+            // Stays 0 if the instruction fails, rather than keeping the value
+            // of whichever record last used the slot
+            record->dest_val = 0;
+            trace_commit(trace);
+        }
+
+        // A memoized CAL is replaced by the recorded effects of the call
+        if (vm->memo == NULL ||
+            !memo_before(vm, current_instruct, limit)) {
+            int status = vm_step(vm, current_instruct);
+            if (status != VM_OK) {
+                return status;
+            }
+            if (vm->memo != NULL) {
+                memo_after(vm, current_instruct);
+            }
+        }
+        if (record != NULL) {
+            record->dest_val = trace_value(vm, current_instruct, record->fp);
+        }
+    }
+}
+
+void vm_print_error(struct vm *vm, int status) {
+    /*
+    * Prints message describing error 'status' returned by vm_run()
+    */
+
+    switch (status) {
+        case VM_LIMIT:
+            printf("Program error: instruction limit reached\n");
+            break;
+        case VM_ERR_ARG_TYPE:
+            printf("Operation could not be executed: Unexpected argument "
+                   "type\n");
+            break;
+        case VM_ERR_NO_FUNC:
+            printf("Program could not be executed: Did not have exactly one "
+                   "function %d\n", vm->error_val);
+            break;
+        case VM_ERR_STACK_OVERFLOW:
+            printf("Program error: stack overflow");
+            break;
+        case VM_ERR_ADDRESS:
+            printf("Program error: stack symbol %d is outside of RAM\n",
+                   vm->error_val);
+            break;
+        case VM_ERR_PC:
+            printf("Program error: program counter is outside of function\n");
+            break;
+    }
+}
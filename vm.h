@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include "parser.h"
 #include "objects.h"
+#include "trace.h"
 
 #define NO_VAL -1
 #define DEFAULT_VAL 0
@@ -15,11 +16,29 @@
 #define PROG_CTR 7
 #define RET_OFFSET 2
 
+// Result of executing instructions; everything after VM_LIMIT is an error
+enum vm_status {
+    VM_OK,                  // Reached end of main()
+    VM_LIMIT,               // Stopped after the requested instruction count
+    VM_ERR_ARG_TYPE,        // Argument type not allowed for the operation
+    VM_ERR_NO_FUNC,         // CAL label matches zero or several functions
+    VM_ERR_STACK_OVERFLOW,  // New stack frame would not fit in RAM
+    VM_ERR_ADDRESS,         // Stack symbol lies beyond the end of RAM
+    VM_ERR_PC               // Execution ran past the end of a function
+};
+
+struct memo;
+
 struct vm {
     BYTE ram[RAM_LIMIT];
     BYTE reg[8];
     struct function code_mem[REG_LIMIT];
     int num_instruct;
+    uint64_t executed;
+    FILE *out;              // Destination of PRINT, or NULL to discard
+    uint8_t error_val;      // Value of the argument that caused an error
+    struct memo *memo;      // Memoized calls, or NULL if disabled
+    int inline_threshold;   // Inlining applied to code_mem, -1 if none
 };
 
 // Helper functions
@@ -41,25 +60,43 @@ void push_to_stack(struct vm *vm, BYTE *value);
 
 void pop_from_stack(struct vm *vm);
 
-void def_new_frame(struct vm *vm);
+int def_new_frame(struct vm *vm);
 
 void set_pc(struct vm *vm, uint8_t num);
 
+int stack_address(struct vm *vm, uint8_t frame, uint8_t symbol);
+
 // Instruction operations
-void op_mov(struct vm *vm, struct instruction *instruct);
+int op_mov(struct vm *vm, struct instruction *instruct);
+
+int op_cal(struct vm *vm, struct instruction *instruct) ;
+
+int op_ret(struct vm *vm);
+
+int op_ref(struct vm *vm, struct instruction *instruct);
+
+int op_add(struct vm *vm, struct instruction *instruct);
+
+int op_print(struct vm *vm, struct instruction *instruct);
+
+int op_not(struct vm *vm, struct instruction *instruct);
 
-void op_cal(struct vm *vm, struct instruction *instruct) ;
+int op_equ(struct vm *vm, struct instruction *instruct);
 
-void op_ret(struct vm *vm);
+// Tracing
+uint8_t read_operand(struct vm *vm, struct instruction *instruct, int arg,
+                     uint8_t frame);
 
-void op_ref(struct vm *vm, struct instruction *instruct);
+uint8_t trace_value(struct vm *vm, struct instruction *instruct,
+                    uint8_t frame);
 
-void op_add(struct vm *vm, struct instruction *instruct);
+// Execution
+void vm_init(struct vm *vm, int main_address);
 
-void op_print(struct vm *vm, struct instruction *instruct);
+int vm_step(struct vm *vm, struct instruction *instruct);
 
-void op_not(struct vm *vm, struct instruction *instruct);
+int vm_run(struct vm *vm, uint64_t limit, struct trace *trace);
 
-void op_equ(struct vm *vm, struct instruction *instruct);
+void vm_print_error(struct vm *vm, int status);
 
-#endif
\ No newline at end of file
+#endif
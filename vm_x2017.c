@@ -1,379 +1,263 @@
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
 #include "vm.h"
+#include "trace.h"
+#include "perf.h"
+#include "snapshot.h"
+#include "memo.h"
+#include "inline.h"
 
-uint8_t is_main(struct vm *vm) {
-    /*
-    * Returns 1 is current function being executed is main(), otherwise
-    * returns 0
-    */
-
-    uint8_t main_add = get_func(vm, 0);
-    if (vm->reg[FUNC_PTR] == main_add) {
-        return 1;
-    }
-    return 0;
-}
-
-uint8_t is_ret(struct vm *vm) {
-    /*
-    * Returns 1 if the current instruction being executed is a RET, otherwise
-    * returns 0
-    */
-
-    struct function func = vm->code_mem[vm->reg[FUNC_PTR]];
-    struct instruction instruct = func.instructions[vm->reg[PROG_CTR]];
-    return (instruct.operation == RET);
-}
-
-int get_func(struct vm *vm, uint8_t label) {
-    /*
-    * Returns index location of function with label 'label' within code memory
-    */
-
-   int result = NO_VAL;
-    int num_func = 0;
-    for (int i = 0; i < vm->num_instruct; i ++) {
-        if (vm->code_mem[i].label == label) {
-            result = i;
-            num_func ++;
+int main(int argc, char **argv) {
+    // Handles command line options
+    char *trace_path = NULL;
+    uint64_t trace_records = TRACE_DEFAULT_RECORDS;
+    uint8_t stats = 0;
+    char *snapshot_path = NULL;
+    uint64_t snapshot_at = 0;
+    uint8_t snapshot_at_set = 0;
+    char *restore_path = NULL;
+    uint64_t runs = 1;
+    uint8_t memoize = 0;
+    int inline_threshold = INLINE_DEFAULT_THRESHOLD;
+    struct option options[] = {
+        {"trace", required_argument, NULL, 't'},
+        {"trace-size", required_argument, NULL, 'n'},
+        {"stats", no_argument, NULL, 's'},
+        {"snapshot", required_argument, NULL, 'o'},
+        {"snapshot-at", required_argument, NULL, 'a'},
+        {"restore", required_argument, NULL, 'r'},
+        {"runs", required_argument, NULL, 'k'},
+        {"memo", no_argument, NULL, 'm'},
+        {"no-inline", no_argument, NULL, 'i'},
+        {"inline-threshold", required_argument, NULL, 'l'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+            case 't':
+                trace_path = optarg;
+                break;
+            case 'n': {
+                char *end;
+                trace_records = strtoull(optarg, &end, 10);
+                if (!isdigit((unsigned char) optarg[0]) || *end != '\0' ||
+                    trace_records == 0 || trace_records > TRACE_MAX_RECORDS) {
+                    printf("Error: Trace size must be a number from 1 to "
+                           "%llu\n", TRACE_MAX_RECORDS);
+                    return 1;
+                }
+                break;
+            }
+            case 's':
+                stats = 1;
+                break;
+            case 'o':
+                snapshot_path = optarg;
+                break;
+            case 'a': {
+                char *end;
+                errno = 0;
+                snapshot_at = strtoull(optarg, &end, 10);
+                if (!isdigit((unsigned char) optarg[0]) || *end != '\0' ||
+                    errno == ERANGE) {
+                    printf("Error: Snapshot point must be a number from 0 "
+                           "to %llu\n", (unsigned long long) UINT64_MAX);
+                    return 1;
+                }
+                snapshot_at_set = 1;
+                break;
+            }
+            case 'r':
+                restore_path = optarg;
+                break;
+            case 'k': {
+                char *end;
+                errno = 0;
+                runs = strtoull(optarg, &end, 10);
+                if (!isdigit((unsigned char) optarg[0]) || *end != '\0' ||
+                    errno == ERANGE || runs == 0) {
+                    printf("Error: Runs must be a number from 1 to %llu\n",
+                           (unsigned long long) UINT64_MAX);
+                    return 1;
+                }
+                break;
+            }
+            case 'm':
+                memoize = 1;
+                break;
+            case 'i':
+                inline_threshold = -1;
+                break;
+            case 'l':
+                inline_threshold = parse_inline_threshold(optarg);
+                if (inline_threshold == -1) {
+                    printf("Error: Inline threshold must be a number from 0 "
+                           "to %d\n", INLINE_MAX_THRESHOLD);
+                    return 1;
+                }
+                break;
+            default:
+                return 1;
         }
     }
-    if (num_func != 1) {
-        return NO_VAL;
-    }
-    return result;
-}
-
-uint8_t is_running(struct vm *vm) {
-    /* 
-    * Returns 1 if program has reached a return operation in main(), i.e. has
-    * reached end of program
-    */
-
-   return !((is_main(vm)) && (is_ret(vm)));
-};
-
-void increment_pc(struct vm *vm) {
-    /*
-    * Increments program counter by one index
-    */
-
-    vm->reg[PROG_CTR] ++;
-}
-
-void increment_sp(struct vm *vm) {
-    /*
-    * Increments stack pointer by one index
-    */
-
-    vm->reg[STK_PTR] ++;
-}
-
-void decrement_sp(struct vm *vm) {
-    /*
-    * Decrements stack pointer by one index
-    */
 
-    vm->reg[STK_PTR] --;
-}
-
-void push_to_stack(struct vm *vm, BYTE *value) {
-    /*
-    * Pushes object at 'value' onto stack
-    */
-
-    vm->ram[vm->reg[STK_PTR]] = *value;
-    increment_sp(vm);
-}
-
-void pop_from_stack(struct vm *vm) {
-    /*
-    * 'Pops' all variables from current stackframe
-    */
-
-    vm->reg[STK_PTR] = vm->reg[FRAME_PTR];
-} 
-
-void def_new_frame(struct vm *vm) {
-    /*
-    * Defines starting point of a new stack frame
-    */
-
-    if (vm->reg[FRAME_PTR] + SYM_BUF + RET_OFFSET >= RAM_LIMIT) {
-        printf("Program error: stack overflow");
-        exit(1);
+    if (snapshot_at_set && snapshot_path == NULL) {
+        printf("Error: --snapshot-at requires --snapshot\n");
+        return 1;
     }
-    vm->reg[FRAME_PTR] += SYM_BUF + RET_OFFSET;
-    vm->reg[STK_PTR] = vm->reg[FRAME_PTR] - RET_OFFSET;
-}
-
-void set_pc(struct vm *vm, uint8_t num) {
-    /*
-    * Sets program counter to address 'num'
-    */
-
-    vm->reg[PROG_CTR] = num;
-}
-
-void op_mov(struct vm *vm, struct instruction *instruct) {
-    /*
-    * Executes MOV operation
-    */
 
-    increment_pc(vm);
-    uint8_t val = instruct->val[0];
-    switch (instruct->type[0]) {
-        case VAL:
-            break;
-        case REG:
-            val = vm->reg[val];
-            break;
-        case STK:
-            val = vm->ram[vm->reg[FRAME_PTR] + val];
-            break;
-        case PTR:
-            val = vm->ram[vm->ram[vm->reg[FRAME_PTR] + val]];
-            break;
-    }
-    
-    uint8_t destination = instruct->val[1];
-    switch (instruct->type[1]) {
-        case REG:
-            vm->reg[destination] = val;
-            break;
-        case STK:
-            vm->ram[vm->reg[FRAME_PTR] + destination] = val;
-            break;
-        case PTR:
-            vm->ram[vm->ram[vm->reg[FRAME_PTR] + destination]] = val;
-            break;
-        default:
-            printf("Operation could not be executed: "
-                   "Unexpected argument type\n");
-            exit(1);
+    // Handles file errors and parses file, unless resuming from a snapshot
+    if (argc - optind != (restore_path == NULL)) {
+        printf("Error: Please provide <filename> as command line argument\n");
+        return 1;
     }
-}
-
-void op_cal(struct vm *vm, struct instruction *instruct) {
-    /*
-    * Executes CAL operation
-    */   
 
-    if (instruct->type[0] != VAL) {
-        printf("Operation could not be executed: Unexpected argument type\n");
-        exit(1);
+    // Hardware counters are measured separately around parsing and execution
+    struct perf_counters counters;
+    struct perf_sample parse_sample = {0};
+    struct perf_sample exec_sample = {0};
+    if (stats) {
+        perf_open(&counters);
+        perf_start(&counters);
     }
-    uint8_t func_address = instruct->val[0];
-    int func_index = get_func(vm, func_address);
-    if (func_index == NO_VAL) {
-        printf("Program could not be executed: Did not have exactly one "
-               "function %d\n", func_address);
-        exit(1);
-    }
-    increment_pc(vm);
-    def_new_frame(vm);
-
-    // Pushes return addresses onto stack
-    push_to_stack(vm, &vm->reg[FUNC_PTR]);
-    push_to_stack(vm, &vm->reg[PROG_CTR]);
 
-    vm->reg[FUNC_PTR] = func_index;
-    set_pc(vm, DEFAULT_VAL);
-}
+    static struct vm vm;
+    struct vm *vm_ptr = &vm;
+    if (restore_path != NULL) {
+        if (snapshot_load(vm_ptr, restore_path) == -1) {
+            printf("Error: Snapshot could not be restored\n");
+            return 1;
+        }
+    } else {
+        FILE *bin_file = fopen(argv[optind], "rb");
+        if (bin_file == NULL) {
+            perror("Error: File could not be opened");
+            return 1;
+        }
 
-void op_ret(struct vm *vm) {
-    /*
-    * Executes RET operation
-    */
+        fseek(bin_file, 0, SEEK_END);
+        int num_bytes = ftell(bin_file);
+        if (num_bytes == 0) {
+            printf("Error: File cannot be empty\n");
+            return 1;
+        }
+        if (num_bytes > BUF) {
+            printf("Error: File is too large\n");
+            return 1;
+        }
+        fseek(bin_file, 0, SEEK_SET);
 
-    increment_pc(vm);
-    pop_from_stack(vm);
-    vm->reg[FRAME_PTR] = vm->reg[FRAME_PTR] - SYM_BUF - RET_OFFSET;
+        BYTE f_bits[BUF] = {0};
+        fread(f_bits, 1, num_bytes, bin_file);
 
-    // Retrieves function return addresses
-    decrement_sp(vm);
-    vm->reg[PROG_CTR] = vm->ram[vm->reg[STK_PTR]];
-    decrement_sp(vm);
-    vm->reg[FUNC_PTR] = vm->ram[vm->reg[STK_PTR]];
-}
+        fclose(bin_file);
 
-void op_ref(struct vm *vm, struct instruction *instruct) {
-    /*
-    * Executes REF operation
-    */
+        // Sets up virtual machine's program code and initialises registers
+        struct function *func_ptr = vm_ptr->code_mem;
+        BYTE *bit_ptr = &f_bits[num_bytes - 1];
+        vm.num_instruct = parse(func_ptr, MAX_FUNC, bit_ptr, num_bytes);
+        if (vm.num_instruct < 0) {
+            printf("Error: %s\n", parse_error(vm.num_instruct));
+            return 1;
+        }
 
-    increment_pc(vm);
+        int main_address = get_func(vm_ptr, 0);
+        if (main_address == NO_VAL) {
+            printf("Program could not be executed: Did not have exactly one "
+                   "main()\n");
+            return 1;
+        }
 
-    uint8_t symbol = instruct->val[0];
-    switch (instruct->type[0]) {
-        case STK:
-            symbol = vm->reg[FRAME_PTR] + symbol;
-            break;
-        case PTR:
-            symbol = vm->ram[vm->reg[FRAME_PTR] + symbol];
-            break;
-        default:
-            printf("Operation could not be executed: Unexpected argument type\n");
-            exit(1);
+        // Splices small leaf functions into their callers to save CAL/RET
+        if (inline_threshold >= 0) {
+            inline_leaves(func_ptr, vm.num_instruct, inline_threshold);
+        }
+        vm_init(vm_ptr, main_address);
+        vm.inline_threshold = inline_threshold;
     }
-
-    uint8_t destination = instruct->val[1];
-    switch (instruct->type[1]) {
-        case REG:
-            vm->reg[destination] = symbol;
-            break;
-        case STK:
-            vm->ram[vm->reg[FRAME_PTR] + destination] = symbol;
-            break;
-        case PTR:
-            vm->ram[vm->ram[vm->reg[FRAME_PTR] + destination]] = symbol;
-            break;
-        default:
-            printf("Operation could not be executed: Unexpected argument "
-                   "type\n");
-            exit(1);
+    if (stats) {
+        perf_stop(&counters, &parse_sample);
     }
-}
-
-void op_add(struct vm *vm, struct instruction *instruct) {
-    /*
-    * Executes ADD operation
-    */
-
-    increment_pc(vm);
-
-    uint8_t reg_one = instruct->val[1];
-    uint8_t reg_two = instruct->val[0];
-    vm->reg[reg_one] = vm->reg[reg_one] + vm->reg[reg_two];
-}
-
-void op_print(struct vm *vm, struct instruction *instruct) {
-    /*
-    * Executes PRINT operation
-    */
-
-    increment_pc(vm);
-
-    uint8_t arg_type = instruct->type[0];
-    uint8_t arg_val = instruct->val[0];
-    switch (arg_type) {
-        case VAL:
-            printf("%d\n", arg_val);
-            break;
-        case REG:
-            printf("%d\n", vm->reg[arg_val]);
-            break;
-        case STK:
-            printf("%d\n", vm->ram[vm->reg[FRAME_PTR] + arg_val]);
-            break;
-        case PTR:
-            printf("%d\n", vm->ram[vm->ram[vm->reg[FRAME_PTR] + arg_val]]);
-            break;
+    if (memoize) {
+        vm.memo = memo_create(vm_ptr);
+        if (vm.memo == NULL) {
+            perror("Error: Memo table could not be set up");
+            return 1;
+        }
     }
-}
-
-void op_not(struct vm *vm, struct instruction *instruct) {
-    /*
-    * Executes NOT operation
-    */
-
-    increment_pc(vm);
-
-    uint8_t reg_add = instruct->val[0];
-    vm->reg[reg_add] = ~(vm->reg[reg_add]);
-}
-
-void op_equ(struct vm *vm, struct instruction *instruct) {
-    /*
-    * Executes EQU operation
-    */
-   
-    increment_pc(vm);
 
-    uint8_t reg_add = instruct->val[0];
-    if (vm->reg[reg_add] == 0) {
-        vm->reg[reg_add] = 1;
-    } else {
-        vm->reg[reg_add] = 0;
+    // Sets up execution trace, which is dumped however the program ends
+    static struct trace trace;
+    struct trace *trace_ptr = NULL;
+    if (trace_path != NULL) {
+        if (trace_init(&trace, trace_path, trace_records) == -1) {
+            perror("Error: Trace could not be set up");
+            return 1;
+        }
+        trace.inline_threshold = vm.inline_threshold;
+        trace_install(&trace);
+        trace_ptr = &trace;
     }
-}
 
-int main(int argc, char **argv) {
-    // Handles file errors and parses file
-    if (argc != 2) {
-        printf("Error: Please provide <filename> as command line argument\n");
-        return 1;
-    }
+    // Keeps the loaded state so that repeated runs only need a memcpy to reset
+    static struct vm loaded;
+    vm_snapshot(&loaded, vm_ptr);
+    uint64_t executed = 0;
+    int result = 0;
 
-    FILE *bin_file = fopen(argv[1], "rb");
-    if (bin_file == NULL) {
-        perror("Error: File could not be opened");
-        return 1;
+    if (stats) {
+        perf_start(&counters);
     }
 
-    fseek(bin_file, 0, SEEK_END);
-    int num_bytes = ftell(bin_file);
-    if (num_bytes == 0) {
-        printf("Error: File cannot be empty\n");
-        return 1;
+    // Executes program until end of main is reached, once per run
+    for (uint64_t run = 0; run < runs; run ++) {
+        if (run > 0) {
+            vm_reset(vm_ptr, &loaded);
+        }
+        uint64_t start = vm.executed;
+
+        if (run == 0 && snapshot_path != NULL) {
+            // A restored run has already counted 'start' instructions
+            uint64_t limit = UINT64_MAX - start < snapshot_at ?
+                             UINT64_MAX : start + snapshot_at;
+            int status = vm_run(vm_ptr, limit, trace_ptr);
+            if (status != VM_OK && status != VM_LIMIT) {
+                vm_print_error(vm_ptr, status);
+                return 1;
+            }
+            if (snapshot_save(vm_ptr, snapshot_path) == -1) {
+                perror("Error: Snapshot could not be saved");
+                return 1;
+            }
+        }
+        int status = vm_run(vm_ptr, UINT64_MAX, trace_ptr);
+        executed += vm.executed - start;
+        if (status != VM_OK) {
+            vm_print_error(vm_ptr, status);
+            result = 1;
+            break;
+        }
     }
-    fseek(bin_file, 0, SEEK_SET);
-
-    BYTE f_bits[BUF] = {0};
-    fread(f_bits, 1, num_bytes, bin_file);
-    
-    fclose(bin_file);
 
-    // Sets up virtual machine's program code and initialises registers
-    struct vm vm;
-    struct vm *vm_ptr = &vm;
-    struct function *func_ptr = vm_ptr->code_mem;
-    BYTE *bit_ptr = &f_bits[num_bytes - 1];
-    vm.num_instruct = parse(func_ptr, bit_ptr, num_bytes);
-
-    int main_address = get_func(vm_ptr, 0);
-    if (main_address == NO_VAL) {
-        printf("Program could not be executed: Did not have exactly one main()"
-               "\n");
-        return 1;
+    if (stats) {
+        perf_stop(&counters, &exec_sample);
     }
 
-    vm.reg[FRAME_PTR] = DEFAULT_VAL;
-    vm.reg[STK_PTR] = DEFAULT_VAL;
-    vm.reg[FUNC_PTR] = main_address;
-    vm.reg[PROG_CTR] = DEFAULT_VAL;
-
-    // Executes program until end of main is reached
-    while (is_running(vm_ptr)) {
-        struct function *current_func = &vm.code_mem \
-                                        [vm.reg[FUNC_PTR]];
-        struct instruction *current_instruct = &current_func->instructions \
-                                               [vm.reg[PROG_CTR]];
-        switch (current_instruct->operation) {
-            case MOV:
-                op_mov(vm_ptr, current_instruct);
-                break;
-            case CAL:
-                op_cal(vm_ptr, current_instruct);
-                break;
-            case RET:
-                op_ret(vm_ptr);
-                break;
-            case REF:
-                op_ref(vm_ptr, current_instruct);
-                break;
-            case ADD:
-                op_add(vm_ptr, current_instruct);
-                break;
-            case PRINT:
-                op_print(vm_ptr, current_instruct);
-                break;
-            case NOT:
-                op_not(vm_ptr, current_instruct);
-                break;
-            case EQU:
-                op_equ(vm_ptr, current_instruct);
-                break;
-        }
+    // A memo hit dispatches only its CAL, not the instructions it replays
+    uint64_t dispatches = executed;
+    if (vm.memo != NULL) {
+        dispatches -= vm.memo->skipped - vm.memo->hits;
+        fflush(stdout);
+        memo_report(stderr, vm.memo);
+        free(vm.memo);
+    }
+    if (stats) {
+        fflush(stdout);
+        perf_report(stderr, &counters, &parse_sample, &exec_sample, executed,
+                    dispatches);
+        perf_close(&counters);
     }
-    return 0;
+    return result;
 }